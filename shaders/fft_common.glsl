@@ -0,0 +1,100 @@
+// FFT di Stockham in memoria condivisa (radice 4, più uno stadio di radice 2 se serve),
+// comune a fft_rows.comp e fft_columns.comp. Un workgroup trasforma una sequenza.
+
+// 2048 valori complessi occupano 16 KB, il minimo di memoria condivisa garantito da
+// Vulkan (EngineConfig::MAX_FFT_LENGTH)
+#define FFT_MAX_LENGTH 2048u
+#define FFT_THREADS    256u
+
+// Valori tenuti da ogni thread in uno stadio: FFT_MAX_LENGTH / FFT_THREADS
+#define FFT_VALUES_PER_THREAD 8u
+
+shared vec2 fft_data[FFT_MAX_LENGTH];
+
+const float PI = 3.14159265358979f;
+
+vec2 complexMul( vec2 a, vec2 b )
+{
+    return vec2( a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x );
+}
+
+// Uno stadio di Stockham: ogni farfalla legge radix valori a distanza length / radix,
+// li ruota con i twiddle e scrive il risultato in ordine naturale. Tutti i thread
+// leggono prima che qualcuno scriva, così fft_data fa da ingresso e da uscita.
+void fftStage( uint length, uint radix, uint span )
+{
+    uint butterflies = length / radix;
+    vec2 values[FFT_VALUES_PER_THREAD];
+    uint count = 0u;
+
+    for ( uint j = gl_LocalInvocationIndex; j < butterflies; j += FFT_THREADS )
+    {
+        float angle = -2.0f * PI * float( j % span ) / float( span * radix );
+
+        for ( uint r = 0u; r < radix; ++r )
+            values[count * radix + r] = complexMul( fft_data[j + r * butterflies], vec2( cos( angle * float( r ) ), sin( angle * float( r ) ) ) );
+
+        ++count;
+    }
+
+    barrier();
+
+    count = 0u;
+
+    for ( uint j = gl_LocalInvocationIndex; j < butterflies; j += FFT_THREADS )
+    {
+        uint base   = ( j / span ) * span * radix + j % span;
+        uint offset = count * radix;
+
+        if ( radix == 4u )
+        {
+            vec2 a0 = values[offset] + values[offset + 2u];
+            vec2 a1 = values[offset] - values[offset + 2u];
+            vec2 a2 = values[offset + 1u] + values[offset + 3u];
+            vec2 d  = values[offset + 1u] - values[offset + 3u];
+            vec2 a3 = vec2( d.y, -d.x );  // -i * d
+
+            fft_data[base]             = a0 + a2;
+            fft_data[base + span]      = a1 + a3;
+            fft_data[base + 2u * span] = a0 - a2;
+            fft_data[base + 3u * span] = a1 - a3;
+        }
+        else
+        {
+            fft_data[base]        = values[offset] + values[offset + 1u];
+            fft_data[base + span] = values[offset] - values[offset + 1u];
+        }
+
+        ++count;
+    }
+
+    barrier();
+}
+
+// Trasformata in avanti di fft_data[0, length), length potenza di due <= FFT_MAX_LENGTH
+void fft( uint length )
+{
+    uint span = 1u;
+
+    for ( ; span * 4u <= length; span *= 4u )
+        fftStage( length, 4u, span );
+
+    if ( span < length )
+        fftStage( length, 2u, span );
+}
+
+// Due sequenze reali di n valori, a nella parte reale e b nell'immaginaria di fft_data[1, n],
+// con fft_data[0] = fft_data[n + 1] = 0: le estende dispari su 2 (n + 1) valori e le
+// trasforma. La FFT di una sequenza reale dispari è immaginaria, quindi per k = 1..n
+// DST-I(a)_k = -Im(fft_data[k]) / 2 e DST-I(b)_k = Re(fft_data[k]) / 2.
+void dstPair( uint n )
+{
+    uint length = 2u * ( n + 1u );
+
+    for ( uint i = gl_LocalInvocationIndex + 1u; i <= n; i += FFT_THREADS )
+        fft_data[length - i] = -fft_data[i];
+
+    barrier();
+
+    fft( length );
+}
@@ -0,0 +1,12 @@
+// Formati delle storage image dei campi. Con -DFP16 (shader *.fp16.comp.spv)
+// i campi sono memorizzati a mezza precisione: imageLoad/imageStore convertono
+// da e verso float, quindi i calcoli negli shader restano a 32 bit.
+#ifdef FP16
+    #define VELOCITY_FORMAT rg16f
+    #define PRESSURE_FORMAT r16f
+    #define IMAGE_FORMAT    rgba16f
+#else
+    #define VELOCITY_FORMAT rg32f
+    #define PRESSURE_FORMAT r32f
+    #define IMAGE_FORMAT    rgba32f
+#endif
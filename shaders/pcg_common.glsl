@@ -0,0 +1,67 @@
+// Risorse comuni ai kernel pcg_*.comp (set 1, Engine::init_pcg)
+
+// Stato del gradiente coniugato: scalari dell'iterazione e dispatch indiretti
+// (Engine::PcgState, std430). A convergenza pcg_reduce.comp azzera i dispatch.
+layout(std430, set = 1, binding = 0) buffer pcg_state
+{
+    float rz;            // r·z
+    float pq;            // p·Ap
+    float alpha;
+    float beta;
+    float max_residual;  // max |r| / 4, la stessa misura di jacobi_residual.comp
+    uint  padding[3];
+    uvec4 dispatch;          // griglia intera
+    uvec4 reduce_dispatch;   // un solo workgroup
+} state;
+
+// Una voce per workgroup della griglia: somma parziale (x) e massimo parziale (y)
+layout(std430, set = 1, binding = 1) buffer pcg_partials
+{
+    vec2 values[];
+} partials;
+
+// Vettori del solver, sempre a 32 bit anche con --fp16
+layout(r32f, set = 1, binding = 2) uniform image2D residual_image;        // r
+layout(r32f, set = 1, binding = 3) uniform image2D preconditioned_image;  // z = M^-1 r
+layout(r32f, set = 1, binding = 4) uniform image2D direction_image;       // p
+layout(r32f, set = 1, binding = 5) uniform image2D product_image;         // q = A p
+
+layout(push_constant) uniform constants
+{
+    uint  phase;          // solo pcg_reduce.comp
+    uint  partial_count;
+    float tolerance;
+} pc;
+
+// I kernel sulla griglia usano workgroup 16x16, pcg_reduce.comp 256x1: 256 thread in entrambi i casi
+#define PCG_REDUCTION_SIZE 256u
+
+shared vec2 reduction[PCG_REDUCTION_SIZE];
+
+// Somma delle x e massimo delle y sul workgroup; tutti i thread devono chiamarla
+vec2 reduceWorkgroup( vec2 value )
+{
+    uint index = gl_LocalInvocationIndex;
+
+    reduction[index] = value;
+    barrier();
+
+    for ( uint stride = PCG_REDUCTION_SIZE / 2u; stride > 0u; stride >>= 1u )
+    {
+        if ( index < stride )
+            reduction[index] = vec2( reduction[index].x + reduction[index + stride].x, max( reduction[index].y, reduction[index + stride].y ) );
+
+        barrier();
+    }
+
+    return reduction[0];
+}
+
+// Riduzione del workgroup nella sua voce di partials, sommata poi da pcg_reduce.comp
+void writePartial( vec2 value )
+{
+    vec2 total = reduceWorkgroup( value );
+
+    if ( gl_LocalInvocationIndex == 0u )
+        partials.values[gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x] = total;
+}
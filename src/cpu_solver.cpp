@@ -0,0 +1,473 @@
+#include "cpu_solver.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+
+#include <vulkan/vulkan.h>
+
+#include "logger.hpp"
+#include "snapshot.hpp"
+#include "stopwatch.hpp"
+
+// Kernel di riga: p, v, ... puntano alla prima cella interna della riga,
+// stride è la distanza fra due righe. L'ordine delle somme è quello degli
+// shader, così le versioni scalare e AVX2 danno lo stesso risultato.
+
+static void jacobi_pressure_row(const float* p, const float* div, float* out, size_t n, ptrdiff_t stride)
+{
+    for (size_t i = 0; i < n; ++i)
+        out[i] = ( p[i + 1] + p[i - 1] + p[i + stride] + p[i - stride] - div[i] ) * 0.25f;
+}
+
+static void diffusion_row(const float* v, float* out, size_t n, ptrdiff_t stride, float dff)
+{
+    for (size_t i = 0; i < n; ++i)
+        out[i] = ( v[i] + dff * 0.25f * ( v[i + 1] + v[i - 1] + v[i + stride] + v[i - stride] ) ) / ( 1.0f + dff );
+}
+
+static void divergence_row(const float* vx, const float* vy, float* div, size_t n, ptrdiff_t stride)
+{
+    for (size_t i = 0; i < n; ++i)
+        div[i] = ( vx[i + 1] - vx[i - 1] ) * 0.5f + ( vy[i + stride] - vy[i - stride] ) * 0.5f;
+}
+
+static void subtract_gradient_row(const float* p, float* vx, float* vy, size_t n, ptrdiff_t stride)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        vx[i] -= ( p[i + 1] - p[i - 1] ) * 0.5f;
+        vy[i] -= ( p[i + stride] - p[i - stride] ) * 0.5f;
+    }
+}
+
+__attribute__((target("avx2")))
+static void jacobi_pressure_row_avx2(const float* p, const float* div, float* out, size_t n, ptrdiff_t stride)
+{
+    const __m256 quarter { _mm256_set1_ps(0.25f) };
+    size_t i {};
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 sum { _mm256_add_ps(_mm256_loadu_ps(p + i + 1), _mm256_loadu_ps(p + i - 1)) };
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(p + i + stride));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(p + i - stride));
+
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_sub_ps(sum, _mm256_loadu_ps(div + i)), quarter));
+    }
+
+    jacobi_pressure_row(p + i, div + i, out + i, n - i, stride);
+}
+
+__attribute__((target("avx2")))
+static void diffusion_row_avx2(const float* v, float* out, size_t n, ptrdiff_t stride, float dff)
+{
+    const __m256 weight      { _mm256_set1_ps(dff * 0.25f) };
+    const __m256 denominator { _mm256_set1_ps(1.0f + dff) };
+    size_t i {};
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 sum { _mm256_add_ps(_mm256_loadu_ps(v + i + 1), _mm256_loadu_ps(v + i - 1)) };
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(v + i + stride));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(v + i - stride));
+
+        __m256 numerator { _mm256_add_ps(_mm256_loadu_ps(v + i), _mm256_mul_ps(weight, sum)) };
+        _mm256_storeu_ps(out + i, _mm256_div_ps(numerator, denominator));
+    }
+
+    diffusion_row(v + i, out + i, n - i, stride, dff);
+}
+
+__attribute__((target("avx2")))
+static void divergence_row_avx2(const float* vx, const float* vy, float* div, size_t n, ptrdiff_t stride)
+{
+    const __m256 half { _mm256_set1_ps(0.5f) };
+    size_t i {};
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 dx { _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(vx + i + 1), _mm256_loadu_ps(vx + i - 1)), half) };
+        __m256 dy { _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(vy + i + stride), _mm256_loadu_ps(vy + i - stride)), half) };
+
+        _mm256_storeu_ps(div + i, _mm256_add_ps(dx, dy));
+    }
+
+    divergence_row(vx + i, vy + i, div + i, n - i, stride);
+}
+
+__attribute__((target("avx2")))
+static void subtract_gradient_row_avx2(const float* p, float* vx, float* vy, size_t n, ptrdiff_t stride)
+{
+    const __m256 half { _mm256_set1_ps(0.5f) };
+    size_t i {};
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 gx { _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(p + i + 1), _mm256_loadu_ps(p + i - 1)), half) };
+        __m256 gy { _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(p + i + stride), _mm256_loadu_ps(p + i - stride)), half) };
+
+        _mm256_storeu_ps(vx + i, _mm256_sub_ps(_mm256_loadu_ps(vx + i), gx));
+        _mm256_storeu_ps(vy + i, _mm256_sub_ps(_mm256_loadu_ps(vy + i), gy));
+    }
+
+    subtract_gradient_row(p + i, vx + i, vy + i, n - i, stride);
+}
+
+static void round_to_half_row(float* values, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        values[i] = (float)(_Float16)values[i];
+}
+
+__attribute__((target("avx2,f16c")))
+static void round_to_half_row_f16c(float* values, size_t n)
+{
+    size_t i {};
+
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(values + i, _mm256_cvtph_ps(_mm256_cvtps_ph(_mm256_loadu_ps(values + i), _MM_FROUND_TO_NEAREST_INT)));
+
+    round_to_half_row(values + i, n - i);
+}
+
+CpuSolver::CpuSolver(const EngineConfig& config) : _width               { config.grid_width },
+                                                   _height              { config.grid_height },
+                                                   _stride              { (size_t)config.grid_width + 2 },
+                                                   _thread_pool         { config.cpu_threads },
+                                                   _half_precision      { config.half_precision },
+                                                   _pressure_iterations { config.pressure_iterations },
+                                                   _pressure_warm_start { config.pressure_warm_start }
+{
+    size_t padded_size { _stride * (_height + 2) };
+
+    for (int i = 0; i < 2; ++i)
+    {
+        _velocity_x[i].assign(padded_size, 0.0f);
+        _velocity_y[i].assign(padded_size, 0.0f);
+        _pressure[i].assign(padded_size, 0.0f);
+    }
+
+    _divergence.assign(padded_size, 0.0f);
+
+    // Le CPU con AVX2 hanno anche F16C, usata per arrotondare i campi con --fp16
+    _avx2 = { __builtin_cpu_supports("avx2") != 0 && __builtin_cpu_supports("f16c") != 0 };
+
+    if (config.obstacles)
+        init_obstacles();
+
+    LOG("CPU solver " + std::to_string(_width) + "x" + std::to_string(_height) + " with "
+        + std::to_string(_thread_pool.size()) + " threads (" + (_avx2 ? "AVX2" : "scalar") + " kernels, "
+        + (_half_precision ? "fp16" : "fp32") + " fields).", COMPONENT_NAME);
+}
+
+size_t CpuSolver::index(uint32_t x, uint32_t y) const
+{
+    return (size_t)(y + 1) * _stride + (x + 1);
+}
+
+void CpuSolver::store_row(float* row) const
+{
+    // Come la imageStore su un'immagine rg16f/r16f: i calcoli restano fp32, il valore salvato no
+    if (!_half_precision)
+        return;
+
+    (_avx2 ? round_to_half_row_f16c : round_to_half_row)(row, _width);
+}
+
+void CpuSolver::init_obstacles()
+{
+    // Stesse sfere (scalate dalla griglia 2560x1080) e stessi bordi di obstacles.comp
+    float scale_x { 2560.0f / _width };
+    float scale_y { 1080.0f / _height };
+
+    auto solid = [&](float x, float y)
+    {
+        float sx { x * scale_x };
+        float sy { y * scale_y };
+
+        return std::hypot(sx - 1100.0f, sy - 500.0f) < 100.0f ||
+               std::hypot(sx - 1200.0f, sy - 300.0f) <  75.0f ||
+               std::hypot(sx - 1400.0f, sy - 500.0f) < 120.0f ||
+               std::hypot(sx - 1250.0f, sy - 425.0f) <  25.0f ||
+               x <= 10.0f || y <= 10.0f || _width - x <= 10.0f || _height - y <= 10.0f;
+    };
+
+    for (uint32_t y = 0; y < _height; ++y)
+        for (uint32_t x = 0; x < _width; ++x)
+            if (solid((float)x, (float)y))
+                _solid_cells.push_back(index(x, y));
+}
+
+void CpuSolver::for_each_row(const std::function<void(uint32_t y)>& row_task)
+{
+    _thread_pool.parallel_for(0, _height, [&](size_t begin, size_t end)
+    {
+        for (size_t y = begin; y < end; ++y)
+            row_task((uint32_t)y);
+    });
+}
+
+void CpuSolver::apply_forces(const PushConstants& pc, float dt)
+{
+    Field& velocity_x { _velocity_x[_velocity_index] };
+    Field& velocity_y { _velocity_y[_velocity_index] };
+
+    // Forza del mouse e poi velocità nulla sugli ostacoli, come jacobi_diffusion.comp
+    if (pc.mouse_down == 1)
+    {
+        int32_t radius { (int32_t)MOUSE_RADIUS };
+
+        for (int32_t y = std::max(pc.mouse_y - radius, 0); y <= std::min(pc.mouse_y + radius, (int32_t)_height - 1); ++y)
+        {
+            for (int32_t x = std::max(pc.mouse_x - radius, 0); x <= std::min(pc.mouse_x + radius, (int32_t)_width - 1); ++x)
+                if (std::hypot((float)(x - pc.mouse_x), (float)(y - pc.mouse_y)) < MOUSE_RADIUS)
+                    velocity_x[index(x, y)] += MOUSE_FORCE * dt;
+
+            store_row(&velocity_x[index(0, y)]);
+        }
+    }
+
+    clear_solid_cells(velocity_x, velocity_y);
+}
+
+void CpuSolver::clear_solid_cells(Field& field_x, Field& field_y)
+{
+    for (size_t cell : _solid_cells)
+    {
+        field_x[cell] = 0.0f;
+        field_y[cell] = 0.0f;
+    }
+}
+
+void CpuSolver::diffuse(const PushConstants& pc, float dt)
+{
+    const float dff { DIFFUSION_RATE * dt };
+    auto row_kernel { _avx2 ? diffusion_row_avx2 : diffusion_row };
+
+    for (int iteration = 0; iteration < DIFFUSION_ITERATIONS; ++iteration)
+    {
+        apply_forces(pc, dt);
+
+        const Field& current_x { _velocity_x[_velocity_index] };
+        const Field& current_y { _velocity_y[_velocity_index] };
+        Field&       next_x    { _velocity_x[1 - _velocity_index] };
+        Field&       next_y    { _velocity_y[1 - _velocity_index] };
+
+        for_each_row([&](uint32_t y)
+        {
+            size_t row { index(0, y) };
+            row_kernel(&current_x[row], &next_x[row], _width, (ptrdiff_t)_stride, dff);
+            row_kernel(&current_y[row], &next_y[row], _width, (ptrdiff_t)_stride, dff);
+            store_row(&next_x[row]);
+            store_row(&next_y[row]);
+        });
+
+        _velocity_index = 1 - _velocity_index;
+    }
+}
+
+void CpuSolver::project()
+{
+    auto divergence_kernel { _avx2 ? divergence_row_avx2 : divergence_row };
+    auto jacobi_kernel     { _avx2 ? jacobi_pressure_row_avx2 : jacobi_pressure_row };
+    auto gradient_kernel   { _avx2 ? subtract_gradient_row_avx2 : subtract_gradient_row };
+
+    Field& velocity_x { _velocity_x[_velocity_index] };
+    Field& velocity_y { _velocity_y[_velocity_index] };
+
+    // La divergenza non cambia durante le iterazioni: si calcola una volta sola
+    for_each_row([&](uint32_t y)
+    {
+        size_t row { index(0, y) };
+        divergence_kernel(&velocity_x[row], &velocity_y[row], &_divergence[row], _width, (ptrdiff_t)_stride);
+    });
+
+    // Senza warm start ogni solve riparte da zero, come Engine::solve_pressure() (l'alone è già a zero)
+    if (!_pressure_warm_start)
+        std::fill(_pressure[_pressure_index].begin(), _pressure[_pressure_index].end(), 0.0f);
+
+    for (uint32_t iteration = 0; iteration < _pressure_iterations; ++iteration)
+    {
+        const Field& current { _pressure[_pressure_index] };
+        Field&       next    { _pressure[1 - _pressure_index] };
+
+        for_each_row([&](uint32_t y)
+        {
+            size_t row { index(0, y) };
+            jacobi_kernel(&current[row], &_divergence[row], &next[row], _width, (ptrdiff_t)_stride);
+            store_row(&next[row]);
+        });
+
+        _pressure_index = 1 - _pressure_index;
+    }
+
+    const Field& pressure { _pressure[_pressure_index] };
+
+    for_each_row([&](uint32_t y)
+    {
+        size_t row { index(0, y) };
+        gradient_kernel(&pressure[row], &velocity_x[row], &velocity_y[row], _width, (ptrdiff_t)_stride);
+        store_row(&velocity_x[row]);
+        store_row(&velocity_y[row]);
+    });
+}
+
+void CpuSolver::advect(float dt)
+{
+    const Field& current_x { _velocity_x[_velocity_index] };
+    const Field& current_y { _velocity_y[_velocity_index] };
+    Field&       next_x    { _velocity_x[1 - _velocity_index] };
+    Field&       next_y    { _velocity_y[1 - _velocity_index] };
+
+    // Fuori dal dominio la velocità vale zero, come la imageLoad dello shader
+    auto load = [this](const Field& field, int32_t x, int32_t y)
+    {
+        if (x < 0 || y < 0 || x >= (int32_t)_width || y >= (int32_t)_height)
+            return 0.0f;
+
+        return field[index(x, y)];
+    };
+
+    const float limit_x { (float)_width + 1.0f };
+    const float limit_y { (float)_height + 1.0f };
+
+    for_each_row([&](uint32_t y)
+    {
+        for (uint32_t x = 0; x < _width; ++x)
+        {
+            size_t cell { index(x, y) };
+
+            // Segue la velocità all'indietro
+            float position_x { x - dt * current_x[cell] };
+            float position_y { y - dt * current_y[cell] };
+
+            if (!(position_x > -2.0f && position_x < limit_x && position_y > -2.0f && position_y < limit_y))
+            {
+                next_x[cell] = 0.0f;
+                next_y[cell] = 0.0f;
+                continue;
+            }
+
+            // ivec2(pos) tronca verso zero, fract() usa floor(): stesso comportamento dello shader
+            int32_t floor_x { (int32_t)position_x };
+            int32_t floor_y { (int32_t)position_y };
+            float   fract_x { position_x - std::floor(position_x) };
+            float   fract_y { position_y - std::floor(position_y) };
+
+            for (int component = 0; component < 2; ++component)
+            {
+                const Field& field { component == 0 ? current_x : current_y };
+
+                float A { load(field, floor_x,     floor_y) };
+                float B { load(field, floor_x + 1, floor_y) };
+                float C { load(field, floor_x,     floor_y + 1) };
+                float D { load(field, floor_x + 1, floor_y + 1) };
+
+                float top    { A * (1.0f - fract_x) + B * fract_x };
+                float bottom { C * (1.0f - fract_x) + D * fract_x };
+
+                (component == 0 ? next_x : next_y)[cell] = top * (1.0f - fract_y) + bottom * fract_y;
+            }
+        }
+
+        store_row(&next_x[index(0, y)]);
+        store_row(&next_y[index(0, y)]);
+    });
+
+    _velocity_index = 1 - _velocity_index;
+}
+
+void CpuSolver::step(const PushConstants& pc)
+{
+    float dt { pc.delta_time };
+
+    // Stesso ordine di Engine::compute_simulation_step()
+    diffuse(pc, dt);
+    project();
+    advect(dt);
+    project();
+}
+
+void CpuSolver::run(const EngineConfig& config)
+{
+    Stopwatch run_stopwatch {};
+    run_stopwatch.start();
+
+    // Stesso passo fisso della GPU: i risultati non dipendono dalla velocità della CPU
+    PushConstants pc {};
+    pc.delta_time = { config.fixed_delta_time };
+
+    // Stessa forzante di Engine::compute_simulation_step() con --inject
+    if (config.inject)
+    {
+        pc.mouse_down = { 1 };
+        pc.mouse_x    = { (int32_t)config.inject_x };
+        pc.mouse_y    = { (int32_t)config.inject_y };
+    }
+
+    uint64_t steps {};
+
+    while (config.max_steps == 0 || steps < config.max_steps)
+    {
+        step(pc);
+        ++steps;
+
+        // Stessi step della GPU con un passo per frame, così gli snapshot si confrontano a coppie
+        if (!config.checkpoint_path.empty() && config.checkpoint_interval > 0 && steps % config.checkpoint_interval == 0)
+            write_snapshot(config.checkpoint_path, steps, config.fixed_delta_time);
+
+        if (!config.export_path.empty() && steps % config.export_interval == 0)
+            write_snapshot(Snapshot::export_file_path(config.export_path, steps), steps, config.fixed_delta_time);
+    }
+
+    if (!config.checkpoint_path.empty() && (config.checkpoint_interval == 0 || steps % config.checkpoint_interval != 0))
+        write_snapshot(config.checkpoint_path, steps, config.fixed_delta_time);
+
+    int64_t run_ms { run_stopwatch.elapsed() };
+    double steps_per_second { run_ms > 0 ? steps * 1000.0 / run_ms : 0.0 };
+
+    LOG("Simulated " + std::to_string(steps) + " steps in " + std::to_string(run_ms) + "ms ("
+        + std::to_string(steps_per_second) + " steps/s).", COMPONENT_NAME);
+}
+
+std::vector<float> CpuSolver::unpadded(const Field& field) const
+{
+    std::vector<float> output((size_t)_width * _height);
+
+    for (uint32_t y = 0; y < _height; ++y)
+        std::copy_n(&field[index(0, y)], _width, &output[(size_t)y * _width]);
+
+    return output;
+}
+
+void CpuSolver::write_snapshot(const std::filesystem::path& path, uint64_t step_count, float delta_time) const
+{
+    std::vector<float> velocity_x { unpadded(_velocity_x[_velocity_index]) };
+    std::vector<float> velocity_y { unpadded(_velocity_y[_velocity_index]) };
+    std::vector<float> pressure   { unpadded(_pressure[_pressure_index]) };
+
+    // Texel rg32f come l'immagine di velocità: x e y alternati cella per cella
+    // (con --fp16 i valori sono già arrotondati, il formato fp32 li conserva esatti)
+    std::vector<float> velocity(velocity_x.size() * 2);
+
+    for (size_t i = 0; i < velocity_x.size(); ++i)
+    {
+        velocity[2 * i]     = velocity_x[i];
+        velocity[2 * i + 1] = velocity_y[i];
+    }
+
+    Snapshot::Header header {};
+    header.magic           = { Snapshot::FILE_MAGIC };
+    header.version         = { Snapshot::FILE_VERSION };
+    header.width           = { _width };
+    header.height          = { _height };
+    header.velocity_format = { (uint32_t)VK_FORMAT_R32G32_SFLOAT };
+    header.pressure_format = { (uint32_t)VK_FORMAT_R32_SFLOAT };
+    header.step_count      = { step_count };
+    header.delta_time      = { delta_time };
+    header.velocity_size   = { velocity.size() * sizeof(float) };
+    header.pressure_size   = { pressure.size() * sizeof(float) };
+
+    Snapshot::write(path, header, { (const char*)velocity.data(), header.velocity_size }, { (const char*)pressure.data(), header.pressure_size });
+}
@@ -0,0 +1,93 @@
+#ifndef CPU_SOLVER_HPP
+#define CPU_SOLVER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "engine_config.hpp"
+#include "thread_pool.hpp"
+
+// Backend CPU di riferimento: gli stessi pass di Engine::compute_simulation_step()
+// (diffusione, pressione di Jacobi, rimozione della divergenza, advezione) su
+// array SoA di float, con kernel AVX2 quando disponibili e righe divise fra i thread.
+class CpuSolver {
+public:
+    static constexpr std::string COMPONENT_NAME { "CPU_SOLVER" };
+
+    // Same meaning as the compute shaders' push constants.
+    struct PushConstants
+    {
+        uint32_t mouse_down   {};
+        float    delta_time   {};
+        int32_t  mouse_x      {};
+        int32_t  mouse_y      {};
+    };
+
+    static constexpr int   DIFFUSION_ITERATIONS { 20 };
+    static constexpr float DIFFUSION_RATE       { 0.004f };
+    static constexpr float MOUSE_FORCE          { 0.003f };
+    static constexpr float MOUSE_RADIUS         { 10.0f };
+
+    // Grid size, threads (config.cpu_threads), obstacle mask (empty with --no-obstacles),
+    // Jacobi iterations and warm start of the pressure solves and field precision come
+    // from config. With config.half_precision every stored
+    // value is rounded to fp16, like the rg16f/r16f images of the GPU backend.
+    explicit CpuSolver(const EngineConfig& config);
+
+    void step(const PushConstants& pc);
+
+    // Runs config.max_steps fixed steps of config.fixed_delta_time milliseconds
+    // (0 = unlimited) and logs steps/s. Checkpoints and exports are written in the
+    // snapshot format of the GPU backend, so --compare works across backends.
+    void run(const EngineConfig& config);
+
+private:
+    // Ogni campo ha un alone di una cella a zero: i vicini fuori dal dominio
+    // valgono 0 come le imageLoad fuori dall'immagine, senza test nei kernel.
+    using Field = std::vector<float>;
+
+    uint32_t _width  {};
+    uint32_t _height {};
+    size_t   _stride {};
+
+    Field _velocity_x[2] {};
+    Field _velocity_y[2] {};
+    Field _pressure[2]   {};
+    Field _divergence    {};
+
+    uint32_t _velocity_index {};
+    uint32_t _pressure_index {};
+
+    // Indici (con alone) delle celle solide: sfere e bordi di obstacles.comp
+    std::vector<size_t> _solid_cells {};
+
+    ThreadPool _thread_pool;
+    bool       _avx2           {};
+    bool       _half_precision {};
+
+    // Come --pressure-iterations e --cold-start sulla GPU
+    uint32_t _pressure_iterations {};
+    bool     _pressure_warm_start {};
+
+    size_t index(uint32_t x, uint32_t y) const;
+
+    void init_obstacles();
+
+    void apply_forces(const PushConstants& pc, float dt);
+    void diffuse(const PushConstants& pc, float dt);
+    void project();
+    void advect(float dt);
+
+    void clear_solid_cells(Field& field_x, Field& field_y);
+    void store_row(float* row) const;
+
+    void for_each_row(const std::function<void(uint32_t y)>& row_task);
+    std::vector<float> unpadded(const Field& field) const;
+    void write_snapshot(const std::filesystem::path& path, uint64_t step_count, float delta_time) const;
+};
+
+#endif // CPU_SOLVER_HPP
@@ -0,0 +1,44 @@
+#include "descriptor_writer.hpp"
+
+void DescriptorWriter::write_image(uint32_t binding, VkImageView image_view, VkSampler sampler, VkImageLayout layout, VkDescriptorType type)
+{
+    VkDescriptorImageInfo& info { _image_infos.emplace_back(VkDescriptorImageInfo { .sampler = sampler, .imageView = image_view, .imageLayout = layout }) };
+
+    VkWriteDescriptorSet write { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+    write.dstBinding      = { binding };
+    write.dstSet          = { VK_NULL_HANDLE };
+    write.descriptorCount = { 1 };
+    write.descriptorType  = { type };
+    write.pImageInfo      = { &info };
+
+    _writes.push_back(write);
+}
+
+void DescriptorWriter::write_buffer(uint32_t binding, VkBuffer buffer, VkDeviceSize size, VkDeviceSize offset, VkDescriptorType type)
+{
+    VkDescriptorBufferInfo& info { _buffer_infos.emplace_back(VkDescriptorBufferInfo { .buffer = buffer, .offset = offset, .range = size }) };
+
+    VkWriteDescriptorSet write { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+    write.dstBinding      = { binding };
+    write.dstSet          = { VK_NULL_HANDLE };
+    write.descriptorCount = { 1 };
+    write.descriptorType  = { type };
+    write.pBufferInfo     = { &info };
+
+    _writes.push_back(write);
+}
+
+void DescriptorWriter::clear()
+{
+    _image_infos.clear();
+    _buffer_infos.clear();
+    _writes.clear();
+}
+
+void DescriptorWriter::update_set(VkDevice device, VkDescriptorSet set)
+{
+    for (VkWriteDescriptorSet& write : _writes)
+        write.dstSet = { set };
+
+    vkUpdateDescriptorSets(device, (uint32_t)_writes.size(), _writes.data(), 0, nullptr);
+}
@@ -0,0 +1,23 @@
+#ifndef DESCRIPTOR_WRITER_HPP
+#define DESCRIPTOR_WRITER_HPP
+
+#include <deque>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+class DescriptorWriter {
+public:
+    void write_image(uint32_t binding, VkImageView image_view, VkSampler sampler, VkImageLayout layout, VkDescriptorType type);
+    void write_buffer(uint32_t binding, VkBuffer buffer, VkDeviceSize size, VkDeviceSize offset, VkDescriptorType type);
+
+    void clear();
+    void update_set(VkDevice device, VkDescriptorSet set);
+
+private:
+    // deque: i puntatori agli info restano validi mentre si aggiungono elementi.
+    std::deque<VkDescriptorImageInfo>  _image_infos  {};
+    std::deque<VkDescriptorBufferInfo> _buffer_infos {};
+    std::vector<VkWriteDescriptorSet>  _writes       {};
+};
+
+#endif // DESCRIPTOR_WRITER_HPP
@@ -1,7 +1,11 @@
 #include "engine.hpp"
 #include "input_handler.hpp"
 #include <SDL2/SDL_events.h>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <sstream>
 #include <vulkan/vulkan_core.h>
 
 #define VMA_IMPLEMENTATION
@@ -10,11 +14,18 @@
 Engine* loaded_engine { nullptr };
 Engine& Engine::Get() { return *loaded_engine; }
 
-Engine::Engine() : _initialized            { false },
-                   _stop_rendering         { false },
-                   _frame_counter          { 0 },
-                   _window_extent          { 2560, 1080 },
-                   _swapchain_image_format { VK_FORMAT_B8G8R8A8_UNORM }
+Engine::Engine() : Engine(EngineConfig {}) {}
+
+Engine::Engine(const EngineConfig& config) : _config                 { config },
+                                             _initialized            { false },
+                                             _stop_rendering         { false },
+                                             _frame_counter          { 0 },
+                                             _window_extent          { config.window_width, config.window_height },
+                                             _swapchain_image_format { VK_FORMAT_B8G8R8A8_UNORM },
+                                             _velocity_format        { config.half_precision ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R32G32_SFLOAT },
+                                             _pressure_format        { config.half_precision ? VK_FORMAT_R16_SFLOAT : VK_FORMAT_R32_SFLOAT },
+                                             _draw_image_format      { config.half_precision ? VK_FORMAT_R16G16B16A16_SFLOAT : VK_FORMAT_R32G32B32A32_SFLOAT },
+                                             _async_compute          { config.async_compute && !config.headless }
 {
     #if DEBUG_LEVEL >= 1
     LOG("Engine instance created.", COMPONENT_NAME);
@@ -31,34 +42,85 @@ void Engine::init()
     assert(loaded_engine == nullptr);
     loaded_engine = { this };
 
-    SDL_Init(SDL_INIT_VIDEO);
-    SDL_WindowFlags window_flags = { (SDL_WindowFlags)(SDL_WINDOW_VULKAN) };
+    // In headless mode there is nothing to show: no window, no surface and no swapchain.
+    if (!_config.headless)
+    {
+        SDL_Init(SDL_INIT_VIDEO);
+        SDL_WindowFlags window_flags = { (SDL_WindowFlags)(SDL_WINDOW_VULKAN) };
+
+        _window_ptr = { SDL_CreateWindow
+                        (
+                            "Dedalo Engine",
+                            SDL_WINDOWPOS_UNDEFINED,
+                            SDL_WINDOWPOS_UNDEFINED,
+                            _window_extent.width,
+                            _window_extent.height,
+                            window_flags
+                        ) };
+    }
 
-    _window_ptr = { SDL_CreateWindow
-                    (
-                        "Dedalo Engine",
-                        SDL_WINDOWPOS_UNDEFINED,
-                        SDL_WINDOWPOS_UNDEFINED,
-                        _window_extent.width,
-                        _window_extent.height,
-                        window_flags
-                    ) };
+    #if DEBUG_LEVEL >= 1
+    if (_config.async_compute && _config.headless)
+        LOG("Async compute has no effect in headless mode: nothing is presented.", COMPONENT_NAME, LogLevel::WARNING);
+    #endif
 
     _stopwatch.start();
 
     init_input_handler();
     init_vulkan();
-    init_swapchain();
+
+    if (!_config.headless)
+        init_swapchain();
+
     init_images();
     init_commands();
     init_sync_structures();
+    init_snapshots();
+
+    if (_config.gpu_profiling)
+        init_gpu_profiler();
+
     init_descriptor_sets();
+    init_pipeline_cache();
     init_pipelines();
 
+    if (_config.pressure_solver == PressureSolver::MULTIGRID)
+        init_multigrid();
+    else if (_config.pressure_solver == PressureSolver::PCG)
+        init_pcg();
+    else if (_config.pressure_solver == PressureSolver::FFT)
+        init_fft();
+
+    if (_config.advection == AdvectionScheme::MACCORMACK)
+        init_maccormack();
+    else if (_sampled_advection)
+        init_sampled_advection();
+
+    // Il PCG controlla la tolleranza da sé, senza il residuo di Jacobi
+    bool jacobi_tolerance { _config.pressure_tolerance > 0.0f && _config.pressure_solver == PressureSolver::JACOBI };
+
+    if (_config.pressure_solver != PressureSolver::MULTIGRID && (jacobi_tolerance || _config.log_residuals))
+        init_residual_checks();
+
+    #if DEBUG_LEVEL >= 1
+    if (_config.log_residuals && _config.pressure_solver == PressureSolver::MULTIGRID)
+        LOG("--log-residuals does not cover the multigrid pressure solver, ignored.", COMPONENT_NAME, LogLevel::WARNING);
+
+    if (_config.pressure_tolerance > 0.0f && _config.pressure_solver != PressureSolver::JACOBI && _config.pressure_solver != PressureSolver::PCG)
+        LOG("--pressure-tolerance applies only to the Jacobi and PCG pressure solvers, ignored.", COMPONENT_NAME, LogLevel::WARNING);
+
+    if (_config.sampled_advection && _config.advection != AdvectionScheme::SEMI_LAGRANGIAN)
+        LOG("--sampled-advection applies only to the semi-Lagrangian advection, ignored.", COMPONENT_NAME, LogLevel::WARNING);
+    #endif
+
+    // Tutte le pipeline sono state create: la cache non crescerà più
+    if (!_config.pipeline_cache_path.empty())
+        _pipeline_cache.save(_device_handle);
+
     _initialized = { true };
 
     #if DEBUG_LEVEL >= 1
-    LOG("Engine initialized.", COMPONENT_NAME);
+    LOG(_config.headless ? "Engine initialized (headless)." : "Engine initialized.", COMPONENT_NAME);
     //LOG("Stopwatch: " + _stopwatch.elapsed_as_string(), COMPONENT_NAME);
     #endif
 }
@@ -69,14 +131,51 @@ std::string spv_direcory_path()
     return spv_path.string() + "/";
 }
 
+std::string Engine::field_shader_path(const std::string& shader_name) const
+{
+    // Gli shader che leggono i campi hanno una variante compilata con -DFP16
+    return spv_direcory_path() + shader_name + (_config.half_precision ? ".fp16.comp.spv" : ".comp.spv");
+}
+
+VkDeviceSize Engine::image_size(const AllocatedImage& image) const
+{
+    VkDeviceSize texel_size {};
+
+    switch (image._image_format)
+    {
+        case VK_FORMAT_R16_SFLOAT:          texel_size = { 2 };  break;
+        case VK_FORMAT_R32_SFLOAT:
+        case VK_FORMAT_R16G16_SFLOAT:       texel_size = { 4 };  break;
+        case VK_FORMAT_R32G32_SFLOAT:
+        case VK_FORMAT_R16G16B16A16_SFLOAT: texel_size = { 8 };  break;
+        case VK_FORMAT_R32G32B32A32_SFLOAT: texel_size = { 16 }; break;
+        default:                            texel_size = { 1 };  break;
+    }
+
+    return texel_size * image._image_extent.width * image._image_extent.height * image._image_extent.depth;
+}
+
 void Engine::run()
 {
     if (!_initialized)
         return;
 
+    Stopwatch run_stopwatch {};
+    run_stopwatch.start();
+
+    // Il clock della simulazione parte dal primo frame, non dall'inizializzazione
+    _stopwatch.start();
+
     // main loop
-    while (!_quit)
+    while (!_quit && !reached_max_steps())
     {
+        // headless runs have no SDL event queue to poll
+        if (_config.headless)
+        {
+            draw();
+            continue;
+        }
+
         // handle events on queue
         _input_handler.handle_events();
 
@@ -89,9 +188,34 @@ void Engine::run()
         }
 
         //_stopwatch.start();
-        draw();
+        if (_async_compute)
+            draw_async();
+        else
+            draw();
         //LOG("Frametime: " + _stopwatch.elapsed_as_string(), COMPONENT_NAME);
     }
+
+    if (_readback_ring.enabled())
+        finish_readbacks();
+
+    #if DEBUG_LEVEL >= 1
+    int64_t run_ms { run_stopwatch.elapsed() };
+    double steps_per_second { run_ms > 0 ? _simulation_step_counter * 1000.0 / run_ms : 0.0 };
+
+    LOG("Simulated " + std::to_string(_simulation_step_counter) + " steps in " + std::to_string(run_ms) + "ms ("
+        + std::to_string(steps_per_second) + " steps/s).", COMPONENT_NAME);
+
+    if (_async_compute)
+        LOG("Presented " + std::to_string(_frame_counter) + " frames (" + std::to_string(run_ms > 0 ? _frame_counter * 1000.0 / run_ms : 0.0) + " frames/s).", COMPONENT_NAME);
+    #endif
+
+    if (_gpu_profiler.enabled())
+        LOG(_gpu_profiler.report(), COMPONENT_NAME);
+}
+
+bool Engine::reached_max_steps() const
+{
+    return _config.max_steps != 0 && _simulation_step_counter >= _config.max_steps;
 }
 
 void Engine::cleanup()
@@ -101,6 +225,12 @@ void Engine::cleanup()
 
     vkDeviceWaitIdle(_device_handle);
 
+    if (_restore_staging_buffer)
+        destroy_buffer(*_restore_staging_buffer);
+
+    vkDestroyCommandPool(_device_handle, _immediate_command_pool_handle, nullptr);
+    vkDestroyFence(_device_handle, _immediate_fence_handle, nullptr);
+
     _deletion_queue.flush(_device_handle);
 
     for (int i = 0; i < FRAME_OVERLAP; ++i)
@@ -110,18 +240,32 @@ void Engine::cleanup()
         vkDestroySemaphore(_device_handle, _frames[i]._render_semaphore_handle, nullptr);
         vkDestroySemaphore(_device_handle, _frames[i]._swapchain_semaphore_handle, nullptr);
 
+        if (_async_compute)
+            vkDestroyCommandPool(_device_handle, _frames[i]._compute_command_pool_handle, nullptr);
+
         _frames[i]._deletion_queue.flush();
     }
 
     _deletion_queue.flush();
 
-    destroy_swapchain();
-    vkDestroySurfaceKHR(_instance_handle, _surface_handle, nullptr);
+    if (_async_compute)
+    {
+        vkDestroySemaphore(_device_handle, _simulation_timeline_handle, nullptr);
+        vkDestroySemaphore(_device_handle, _present_timeline_handle, nullptr);
+    }
+
+    if (!_config.headless)
+    {
+        destroy_swapchain();
+        vkDestroySurfaceKHR(_instance_handle, _surface_handle, nullptr);
+    }
+
     vkDestroyDevice(_device_handle, nullptr);
     vkb::destroy_debug_utils_messenger(_instance_handle, _debug_messenger_handle);
     vkDestroyInstance(_instance_handle, nullptr);
 
-    SDL_DestroyWindow(_window_ptr);
+    if (!_config.headless)
+        SDL_DestroyWindow(_window_ptr);
 
     loaded_engine = { nullptr };
 
@@ -147,6 +291,7 @@ void Engine::init_vulkan()
     #if DEBUG_LEVEL == 0
     vkb::Instance vkb_instance_handle { builder.set_app_name("dedalo_engine")
                                         .request_validation_layers(false)
+                                        .set_headless(_config.headless)
                                         .use_default_debug_messenger()
                                         .require_api_version(1, 3, 0)
                                         .build()
@@ -156,6 +301,7 @@ void Engine::init_vulkan()
     #if DEBUG_LEVEL >= 1
     vkb::Instance vkb_instance_handle { builder.set_app_name("dedalo_engine")
                                         .request_validation_layers(true)
+                                        .set_headless(_config.headless)
                                         .use_default_debug_messenger()
                                         .require_api_version(1, 3, 0)
                                         .build()
@@ -165,7 +311,8 @@ void Engine::init_vulkan()
     _instance_handle        = { vkb_instance_handle.instance };
     _debug_messenger_handle = { vkb_instance_handle.debug_messenger };
 
-    SDL_Vulkan_CreateSurface(_window_ptr, _instance_handle, &_surface_handle);
+    if (!_config.headless)
+        SDL_Vulkan_CreateSurface(_window_ptr, _instance_handle, &_surface_handle);
 
     VkPhysicalDeviceVulkan13Features features13 {};
     features13.dynamicRendering = { true };
@@ -174,15 +321,23 @@ void Engine::init_vulkan()
     VkPhysicalDeviceVulkan12Features features12 {};
     features12.bufferDeviceAddress = { true };
     features12.descriptorIndexing  = { true };
+    features12.timelineSemaphore   = { true };
+
+    // rg32f (rg16f e r16f con --fp16) come formati di storage image dei campi
+    VkPhysicalDeviceFeatures features {};
+    features.shaderStorageImageExtendedFormats = { true };
 
     vkb::PhysicalDeviceSelector physical_device_selector { vkb_instance_handle };
-    vkb::PhysicalDevice         physical_device_selected { physical_device_selector
-                                                            .set_minimum_version(1, 3)
-                                                            .set_required_features_13(features13)
-                                                            .set_required_features_12(features12)
-                                                            .set_surface(_surface_handle)
-                                                            .select()
-                                                            .value() };
+    physical_device_selector.set_minimum_version(1, 3)
+                            .set_required_features_13(features13)
+                            .set_required_features_12(features12)
+                            .set_required_features(features);
+
+    // A headless instance selects devices without present support (e.g. lavapipe).
+    if (!_config.headless)
+        physical_device_selector.set_surface(_surface_handle);
+
+    vkb::PhysicalDevice physical_device_selected { physical_device_selector.select().value() };
 
     vkb::DeviceBuilder device_builder { physical_device_selected };
     vkb::Device        device_builded { device_builder.build().value() };
@@ -192,6 +347,27 @@ void Engine::init_vulkan()
     _graphics_queue_handle  = { device_builded.get_queue(vkb::QueueType::graphics).value() };
     _graphics_queue_family  = { device_builded.get_queue_index(vkb::QueueType::graphics).value() };
 
+    _compute_queue_handle = { _graphics_queue_handle };
+    _compute_queue_family = { _graphics_queue_family };
+
+    // Una famiglia di compute separata lavora in parallelo alla grafica; altrimenti
+    // la simulazione resta sulla coda grafica ma sempre sincronizzata con le timeline.
+    if (_async_compute)
+    {
+        auto compute_queue_family { device_builded.get_queue_index(vkb::QueueType::compute) };
+
+        if (compute_queue_family.has_value())
+        {
+            _compute_queue_handle = { device_builded.get_queue(vkb::QueueType::compute).value() };
+            _compute_queue_family = { compute_queue_family.value() };
+        }
+
+        #if DEBUG_LEVEL >= 1
+        else
+            LOG("No separate compute queue family: the simulation shares the graphics queue.", COMPONENT_NAME, LogLevel::WARNING);
+        #endif
+    }
+
     VmaAllocatorCreateInfo allocator_create_info {};
     allocator_create_info.physicalDevice = { _physical_device_handle };
     allocator_create_info.device         = { _device_handle };
@@ -247,6 +423,27 @@ void Engine::init_commands()
 
         result_check(vkAllocateCommandBuffers(_device_handle, &cmd_alloc_info, &_frames[i]._command_buffer_handle));
     }
+
+    VkCommandPoolCreateInfo immediate_pool_info { vkinit::command_pool_create_info(_compute_queue_family, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT) };
+    result_check(vkCreateCommandPool(_device_handle, &immediate_pool_info, nullptr, &_immediate_command_pool_handle));
+
+    VkCommandBufferAllocateInfo immediate_alloc_info { vkinit::command_buffer_allocate_info(_immediate_command_pool_handle, 1) };
+    result_check(vkAllocateCommandBuffers(_device_handle, &immediate_alloc_info, &_immediate_command_buffer_handle));
+
+    if (!_async_compute)
+        return;
+
+    // I batch di simulazione si registrano sulla famiglia della coda di compute
+    VkCommandPoolCreateInfo compute_pool_info { vkinit::command_pool_create_info(_compute_queue_family, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT) };
+
+    for (int i = 0; i < FRAME_OVERLAP; i++)
+    {
+        result_check(vkCreateCommandPool(_device_handle, &compute_pool_info, nullptr, &_frames[i]._compute_command_pool_handle));
+
+        VkCommandBufferAllocateInfo cmd_alloc_info { vkinit::command_buffer_allocate_info(_frames[i]._compute_command_pool_handle, 1) };
+
+        result_check(vkAllocateCommandBuffers(_device_handle, &cmd_alloc_info, &_frames[i]._compute_command_buffer_handle));
+    }
 }
 
 void Engine::init_sync_structures()
@@ -265,40 +462,157 @@ void Engine::init_sync_structures()
         result_check(vkCreateSemaphore(_device_handle, &semaphore_create_info, nullptr, &_frames[i]._swapchain_semaphore_handle));
         result_check(vkCreateSemaphore(_device_handle, &semaphore_create_info, nullptr, &_frames[i]._render_semaphore_handle));
     }
+
+    result_check(vkCreateFence(_device_handle, &fence_create_info, nullptr, &_immediate_fence_handle));
+
+    if (!_async_compute)
+        return;
+
+    VkSemaphoreTypeCreateInfo timeline_type_info {};
+    timeline_type_info.sType         = { VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+    timeline_type_info.pNext         = { nullptr };
+    timeline_type_info.semaphoreType = { VK_SEMAPHORE_TYPE_TIMELINE };
+    timeline_type_info.initialValue  = { 0 };
+
+    VkSemaphoreCreateInfo timeline_create_info { vkinit::semaphore_create_info() };
+    timeline_create_info.pNext = { &timeline_type_info };
+
+    result_check(vkCreateSemaphore(_device_handle, &timeline_create_info, nullptr, &_simulation_timeline_handle));
+    result_check(vkCreateSemaphore(_device_handle, &timeline_create_info, nullptr, &_present_timeline_handle));
+}
+
+void Engine::init_gpu_profiler()
+{
+    _gpu_profiler.init(_device_handle, _physical_device_handle, _compute_queue_family, FRAME_OVERLAP);
+    _deletion_queue.enqueue_deletor( [&]() { _gpu_profiler.destroy(_device_handle); } );
 }
 
 void Engine::init_images()
 {
-    VkExtent3D draw_image_extent { _window_extent.width, _window_extent.height, 1 };
+    // La griglia non dipende dalla finestra: il blit finale adatta l'immagine alla swapchain
+    VkExtent3D draw_image_extent { _config.grid_width, _config.grid_height, 1 };
+
+    VkImageUsageFlags image_usages {};
+    image_usages |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    image_usages |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    image_usages |= VK_IMAGE_USAGE_STORAGE_BIT;
+    image_usages |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+    _draw_image = { create_image(_draw_image_format, draw_image_extent, image_usages) };
+
+    // I campi vengono letti e scritti solo dagli shader di compute
+    VkImageUsageFlags field_usages {};
+    field_usages |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    field_usages |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    field_usages |= VK_IMAGE_USAGE_STORAGE_BIT;
 
-    for (AllocatedImage& image : _images)
+    for (AllocatedImage& image : _pressure_images)
+        image = { create_image(_pressure_format, draw_image_extent, field_usages) };
+
+    // L'advezione con sampler legge la velocità anche come texture filtrata
+    if (_config.sampled_advection && _config.advection == AdvectionScheme::SEMI_LAGRANGIAN)
     {
-        image._image_format = { VK_FORMAT_R32G32B32A32_SFLOAT };
-        image._image_extent = { draw_image_extent };
+        _sampled_advection = { linear_filter_supported(_velocity_format) };
+
+        #if DEBUG_LEVEL >= 1
+        if (!_sampled_advection)
+            LOG("The velocity format does not support linear filtering, --sampled-advection ignored.", COMPONENT_NAME, LogLevel::WARNING);
+        #endif
+    }
 
-        VkImageUsageFlags image_usages {};
-        image_usages |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-        image_usages |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-        image_usages |= VK_IMAGE_USAGE_STORAGE_BIT;
-        image_usages |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (_sampled_advection)
+        field_usages |= VK_IMAGE_USAGE_SAMPLED_BIT;
 
-        VkImageCreateInfo image_create_info = vkinit::image_create_info(image._image_format, image_usages, image._image_extent);
+    for (AllocatedImage& image : _velocity_images)
+        image = { create_image(_velocity_format, draw_image_extent, field_usages) };
 
-        VmaAllocationCreateInfo image_alloc_info {};
-        image_alloc_info.usage         = { VMA_MEMORY_USAGE_GPU_ONLY };
-        image_alloc_info.requiredFlags = { VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) };
-        vmaCreateImage(_allocator, &image_create_info, &image_alloc_info, &image._image_handle, &image._allocation, nullptr);
+    // Un byte per cella: 1 = ostacolo (sfere e bordi), 0 = fluido
+    _obstacle_image = { create_image(VK_FORMAT_R8_UINT, draw_image_extent, VK_IMAGE_USAGE_STORAGE_BIT) };
 
-        VkImageViewCreateInfo imageview_create_info = vkinit::imageview_create_info(image._image_format, image._image_handle, VK_IMAGE_ASPECT_COLOR_BIT);
-        result_check(vkCreateImageView(_device_handle, &imageview_create_info, nullptr, &image._image_view_handle));
+    if (!_async_compute)
+        return;
 
-        _deletion_queue.enqueue_deletor(
-            [this, image](){
-                vkDestroyImageView(_device_handle, image._image_view_handle, nullptr);
-                vmaDestroyImage(_allocator, image._image_handle, image._allocation);
-            }
-        );
+    // Scritte dalla coda di compute e lette dalla coda grafica: condivise fra le due famiglie
+    std::array<uint32_t, 2> queue_families { _graphics_queue_family, _compute_queue_family };
+    VkImageUsageFlags       display_usages { VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT };
+
+    for (AllocatedImage& image : _display_images)
+        image = { create_image(_draw_image_format, draw_image_extent, display_usages, queue_families) };
+}
+
+Engine::AllocatedImage Engine::create_image(VkFormat format, VkExtent3D extent, VkImageUsageFlags usages, std::span<const uint32_t> queue_families)
+{
+    AllocatedImage image {};
+    image._image_format = { format };
+    image._image_extent = { extent };
+
+    VkImageCreateInfo image_create_info = vkinit::image_create_info(image._image_format, usages, image._image_extent);
+
+    if (queue_families.size() > 1 && queue_families[0] != queue_families[1])
+    {
+        image_create_info.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+        image_create_info.queueFamilyIndexCount = (uint32_t)queue_families.size();
+        image_create_info.pQueueFamilyIndices   = queue_families.data();
     }
+
+    VmaAllocationCreateInfo image_alloc_info {};
+    image_alloc_info.usage         = { VMA_MEMORY_USAGE_GPU_ONLY };
+    image_alloc_info.requiredFlags = { VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) };
+    vmaCreateImage(_allocator, &image_create_info, &image_alloc_info, &image._image_handle, &image._allocation, nullptr);
+
+    VkImageViewCreateInfo imageview_create_info = vkinit::imageview_create_info(image._image_format, image._image_handle, VK_IMAGE_ASPECT_COLOR_BIT);
+    result_check(vkCreateImageView(_device_handle, &imageview_create_info, nullptr, &image._image_view_handle));
+
+    _deletion_queue.enqueue_deletor(
+        [this, image](){
+            vkDestroyImageView(_device_handle, image._image_view_handle, nullptr);
+            vmaDestroyImage(_allocator, image._image_handle, image._allocation);
+        }
+    );
+
+    return image;
+}
+
+Engine::AllocatedBuffer Engine::create_buffer(size_t size, VkBufferUsageFlags usages, VmaAllocationCreateFlags allocation_flags)
+{
+    VkBufferCreateInfo buffer_create_info {};
+    buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.pNext = nullptr;
+    buffer_create_info.size  = size;
+    buffer_create_info.usage = usages;
+
+    VmaAllocationCreateInfo buffer_alloc_info {};
+    buffer_alloc_info.usage = { VMA_MEMORY_USAGE_AUTO };
+    buffer_alloc_info.flags = { allocation_flags };
+
+    AllocatedBuffer buffer {};
+    result_check(vmaCreateBuffer(_allocator, &buffer_create_info, &buffer_alloc_info, &buffer._buffer_handle, &buffer._allocation, &buffer._allocation_info));
+
+    return buffer;
+}
+
+void Engine::destroy_buffer(const AllocatedBuffer& buffer)
+{
+    vmaDestroyBuffer(_allocator, buffer._buffer_handle, buffer._allocation);
+}
+
+void Engine::immediate_submit(std::function<void(VkCommandBuffer cmd_buff)>&& function)
+{
+    result_check(vkResetFences(_device_handle, 1, &_immediate_fence_handle));
+    result_check(vkResetCommandBuffer(_immediate_command_buffer_handle, 0));
+
+    VkCommandBufferBeginInfo cmd_buff_begin_info { vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) };
+    result_check(vkBeginCommandBuffer(_immediate_command_buffer_handle, &cmd_buff_begin_info));
+
+    function(_immediate_command_buffer_handle);
+
+    result_check(vkEndCommandBuffer(_immediate_command_buffer_handle));
+
+    VkCommandBufferSubmitInfo cmd_buff_info { vkinit::command_buffer_submit_info(_immediate_command_buffer_handle) };
+    VkSubmitInfo2 submit { vkinit::submit_info(&cmd_buff_info, nullptr, nullptr) };
+
+    result_check(vkQueueSubmit2(_compute_queue_handle, 1, &submit, _immediate_fence_handle));
+    result_check(vkWaitForFences(_device_handle, 1, &_immediate_fence_handle, true, ONE_SECOND * 10));
 }
 
 void Engine::copy_image_to_image(VkCommandBuffer cmd, VkImage source, VkImage destination, VkExtent2D src_size, VkExtent2D dst_size)
@@ -391,6 +705,11 @@ void Engine::draw()
 
     current_frame()._deletion_queue.flush();
 
+    // Il fence copre anche la copia dei campi registrata FRAME_OVERLAP frame fa:
+    // il ring la consuma sul suo thread, senza altre attese qui
+    consume_readback(current_frame()._pending_readback);
+    consume_residual_history(current_frame());
+
     result_check
     (
         vkResetFences
@@ -403,54 +722,57 @@ void Engine::draw()
 
     uint32_t swapchain_image_index {};
 
-    result_check
-    (
-        vkAcquireNextImageKHR
+    if (!_config.headless)
+    {
+        result_check
         (
-            _device_handle,
-            _swapchain_handle,
-            ONE_SECOND,
-            current_frame()._swapchain_semaphore_handle,
-            nullptr,
-            &swapchain_image_index
-        )
-    );
+            vkAcquireNextImageKHR
+            (
+                _device_handle,
+                _swapchain_handle,
+                ONE_SECOND,
+                current_frame()._swapchain_semaphore_handle,
+                nullptr,
+                &swapchain_image_index
+            )
+        );
+    }
 
     VkCommandBuffer cmd_buff { current_frame()._command_buffer_handle };
     result_check(vkResetCommandBuffer(cmd_buff, 0));
 
-    _draw_extent.width  = _images[0]._image_extent.width;
-    _draw_extent.height = _images[0]._image_extent.height;
+    _draw_extent.width  = _velocity_images[0]._image_extent.width;
+    _draw_extent.height = _velocity_images[0]._image_extent.height;
 
     VkCommandBufferBeginInfo cmd_buff_begin_info { vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) };
     result_check(vkBeginCommandBuffer(cmd_buff, &cmd_buff_begin_info));
 
-    //////////
+    // Il fence appena atteso copre il frame registrato FRAME_OVERLAP step fa:
+    // i suoi timestamp sono pronti e si leggono senza attendere la GPU.
+    _gpu_profiler.begin_frame(_device_handle, cmd_buff, _frame_counter % FRAME_OVERLAP);
 
-    transition_image_layout(cmd_buff, _images[2]._image_handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    if (_gpu_profiler.enabled() && _frame_counter > 0 && _frame_counter % GpuProfiler::HISTORY_SIZE == 0)
+        LOG(_gpu_profiler.report(), COMPONENT_NAME);
 
-    if (_frame_counter == 0)
-    {
-        transition_image_layout(cmd_buff, _images[1]._image_handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-        transition_image_layout(cmd_buff, _images[0]._image_handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-    }
+    //////////
 
-    else
-    {
-        transition_image_layout(cmd_buff, _images[1]._image_handle, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
-        transition_image_layout(cmd_buff, _images[0]._image_handle, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
-    }
+    uint32_t substeps { simulation_substeps() };
 
-    //////////
+    for (uint32_t step = 0; step < substeps; ++step)
+        record_simulation_step(cmd_buff);
 
-    compute_simulation_step(cmd_buff);
+    record_due_readbacks(cmd_buff);
 
     //////////
 
-    transition_image_layout(cmd_buff, _images[2]._image_handle, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-    transition_image_layout(cmd_buff, _swapchain_image_handles[swapchain_image_index], VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    copy_image_to_image(cmd_buff, _images[2]._image_handle, _swapchain_image_handles[swapchain_image_index], _draw_extent, _swapchain_extent);
-    transition_image_layout(cmd_buff, _swapchain_image_handles[swapchain_image_index], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    if (!_config.headless)
+    {
+        // Senza step in questo frame _draw_image è ancora in TRANSFER_SRC dal frame precedente
+        if (substeps > 0)
+            transition_image_layout(cmd_buff, _draw_image._image_handle, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+        blit_to_swapchain(cmd_buff, _draw_image._image_handle, swapchain_image_index);
+    }
 
     //////////
 
@@ -460,6 +782,16 @@ void Engine::draw()
 
     VkCommandBufferSubmitInfo cmd_buff_info { vkinit::command_buffer_submit_info(cmd_buff) };
 
+    // Headless: nessuna immagine da acquisire né da presentare, basta il fence del frame.
+    if (_config.headless)
+    {
+        VkSubmitInfo2 submit { vkinit::submit_info(&cmd_buff_info, nullptr, nullptr) };
+        result_check(vkQueueSubmit2(_graphics_queue_handle, 1, &submit, current_frame()._render_fence_handle));
+
+        _frame_counter++;
+        return;
+    }
+
     VkSemaphoreSubmitInfo wait_info {
         vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, current_frame()._swapchain_semaphore_handle)
     };
@@ -486,283 +818,2021 @@ void Engine::draw()
     _frame_counter++;
 }
 
-void Engine::init_pipelines()
+uint32_t Engine::simulation_substeps()
 {
-    init_compute_pipeline(_advection_pipeline_handle, _advection_pipeline_layout_handle, spv_direcory_path() + "advection.comp.spv");
-    init_compute_pipeline(_swap_pipeline_handle, _swap_pipeline_layout_handle, spv_direcory_path() + "swap.comp.spv");
-    init_compute_pipeline(_jacobi_diffusion_pipeline_handle, _jacobi_diffusion_pipeline_layout_handle, spv_direcory_path() + "jacobi_diffusion.comp.spv");
-    init_compute_pipeline(_jacobi_pressure_pipeline_handle, _jacobi_pressure_pipeline_layout_handle, spv_direcory_path() + "jacobi_pressure.comp.spv");
-    init_compute_pipeline(_remove_divergency_pipeline_handle, _remove_divergency_pipeline_layout_handle, spv_direcory_path() + "remove_divergency.comp.spv");
-}
+    double frame_time { _stopwatch.elapsed_milliseconds() };
+    _stopwatch.start();
 
-void Engine::init_compute_pipeline(VkPipeline& pipeline_handle, VkPipelineLayout& pipeline_layout_handle, const std::string& spv_path)
-{
-    VkPushConstantRange push_constant_range {};
-    push_constant_range.offset     = 0;
-    push_constant_range.size       = sizeof(ComputePushConstants);
-    push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    // Numero fisso di step per frame: headless e --steps-per-frame non seguono il tempo reale
+    if (_config.steps_per_frame > 0)
+        return _config.steps_per_frame;
 
-    VkPipelineLayoutCreateInfo pipeline_layout_create_info {};
-    pipeline_layout_create_info.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipeline_layout_create_info.pNext                  = nullptr;
-    pipeline_layout_create_info.pSetLayouts            = &_descriptor_set_layout_handle;
-    pipeline_layout_create_info.setLayoutCount         = 1;
-    pipeline_layout_create_info.pPushConstantRanges    = &push_constant_range;
-    pipeline_layout_create_info.pushConstantRangeCount = 1;
+    if (_config.headless)
+        return 1;
 
-    result_check(vkCreatePipelineLayout(_device_handle, &pipeline_layout_create_info, nullptr, &pipeline_layout_handle));
+    const double delta_time { _config.fixed_delta_time };
 
-    VkShaderModule shader_module {};
+    _simulation_accumulator += frame_time;
 
-    if (!load_shader_module(spv_path, shader_module))
+    uint32_t substeps { (uint32_t)(_simulation_accumulator / delta_time) };
+
+    // Oltre max_substeps il tempo in eccesso si scarta: un frame lento non deve
+    // produrre un frame ancora più lento (spirale di morte)
+    if (substeps > _config.max_substeps)
     {
-        #if DEBUG_LEVEL >= 1
-        LOG("Error when building the compute shader.", COMPONENT_NAME);
-        #endif
+        substeps                = { _config.max_substeps };
+        _simulation_accumulator = { std::fmod(_simulation_accumulator, delta_time) };
     }
 
-    VkPipelineShaderStageCreateInfo pipeline_shader_stage_create_info {};
-    pipeline_shader_stage_create_info.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    pipeline_shader_stage_create_info.pNext  = nullptr;
-    pipeline_shader_stage_create_info.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
-    pipeline_shader_stage_create_info.module = shader_module;
-    pipeline_shader_stage_create_info.pName  = "main";
-
-    VkComputePipelineCreateInfo compute_pipeline_create_info{};
-    compute_pipeline_create_info.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-    compute_pipeline_create_info.pNext  = nullptr;
-    compute_pipeline_create_info.layout = pipeline_layout_handle;
-    compute_pipeline_create_info.stage  = pipeline_shader_stage_create_info;
-
-    result_check(vkCreateComputePipelines(_device_handle, VK_NULL_HANDLE, 1, &compute_pipeline_create_info, nullptr, &pipeline_handle));
+    else
+        _simulation_accumulator -= substeps * delta_time;
 
-    vkDestroyShaderModule(_device_handle, shader_module, nullptr);
+    // Il primo step inizializza i campi e rasterizza gli ostacoli
+    if (!_fields_initialized)
+        substeps = { std::max(substeps, 1u) };
 
-    _deletion_queue.enqueue_deletor(
-        [&]() {
-            vkDestroyPipelineLayout(_device_handle, pipeline_layout_handle, nullptr);
-            vkDestroyPipeline(_device_handle, pipeline_handle, nullptr);
-        }
-    );
+    return substeps;
 }
 
-void Engine::init_descriptor_sets()
+void Engine::record_simulation_step(VkCommandBuffer cmd_buff)
 {
-    size_t image_count { _images.size() };
+    transition_image_layout(cmd_buff, _draw_image._image_handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
 
-    std::vector<DescriptorAllocator::PoolSizeRatio> sizes =
+    if (!_fields_initialized)
     {
-        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, static_cast<float>(image_count * 2)  }
-    };
+        for (int i = 0; i < 2; ++i)
+        {
+            transition_image_layout(cmd_buff, _velocity_images[i]._image_handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+            transition_image_layout(cmd_buff, _pressure_images[i]._image_handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+        }
 
-    _global_descriptor_allocator.init_pool(_device_handle, 10, sizes);
+        transition_image_layout(cmd_buff, _obstacle_image._image_handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
 
-    DescriptorLayoutBuilder layout_builder {};
+        for (const MultigridLevel& level : _multigrid_levels)
+        {
+            transition_image_layout(cmd_buff, level._error_images[0]._image_handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+            transition_image_layout(cmd_buff, level._error_images[1]._image_handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+            transition_image_layout(cmd_buff, level._rhs_image._image_handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+        }
 
-    for (uint32_t i {}; i < image_count; ++i)
-    {
-        layout_builder.add_binding(i, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-    }
+        if (_config.pressure_solver == PressureSolver::PCG)
+        {
+            for (const AllocatedImage& image : _pcg_images)
+                transition_image_layout(cmd_buff, image._image_handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+        }
 
-    _descriptor_set_layout_handle = layout_builder.build(_device_handle, VK_SHADER_STAGE_COMPUTE_BIT);
-    _descriptor_set_0_handle      = _global_descriptor_allocator.allocate(_device_handle, _descriptor_set_layout_handle);
-    _descriptor_set_1_handle      = _global_descriptor_allocator.allocate(_device_handle, _descriptor_set_layout_handle);
-
-    VkDescriptorImageInfo desc_image_0_info {};
-    desc_image_0_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-    desc_image_0_info.imageView   = _images[0]._image_view_handle;
-
-    VkDescriptorImageInfo desc_image_1_info {};
-    desc_image_1_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-    desc_image_1_info.imageView   = _images[1]._image_view_handle;
-
-    VkDescriptorImageInfo desc_image_2_info {};
-    desc_image_2_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-    desc_image_2_info.imageView   = _images[2]._image_view_handle;
-
-    // Configura il primo DescriptorSet (image_0 -> input, image_1 -> output)
-    VkWriteDescriptorSet descriptor_writes_0[3] {};
-
-    descriptor_writes_0[0].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptor_writes_0[0].dstBinding      = 0;
-    descriptor_writes_0[0].dstSet          = _descriptor_set_0_handle;
-    descriptor_writes_0[0].descriptorCount = 1;
-    descriptor_writes_0[0].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    descriptor_writes_0[0].pImageInfo      = &desc_image_0_info;
-
-    descriptor_writes_0[1].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptor_writes_0[1].dstBinding      = 1;
-    descriptor_writes_0[1].dstSet          = _descriptor_set_0_handle;
-    descriptor_writes_0[1].descriptorCount = 1;
-    descriptor_writes_0[1].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    descriptor_writes_0[1].pImageInfo      = &desc_image_1_info;
-
-    descriptor_writes_0[2].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptor_writes_0[2].dstBinding      = 2;
-    descriptor_writes_0[2].dstSet          = _descriptor_set_0_handle;
-    descriptor_writes_0[2].descriptorCount = 1;
-    descriptor_writes_0[2].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    descriptor_writes_0[2].pImageInfo      = &desc_image_2_info;
-
-    vkUpdateDescriptorSets(_device_handle, 3, descriptor_writes_0, 0, nullptr);
-
-    // Configura il secondo DescriptorSet (image_1 -> input, image_0 -> output)
-    VkWriteDescriptorSet descriptor_writes_1[3] {};
-
-    descriptor_writes_1[0].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptor_writes_1[0].dstBinding      = 0;
-    descriptor_writes_1[0].dstSet          = _descriptor_set_1_handle;
-    descriptor_writes_1[0].descriptorCount = 1;
-    descriptor_writes_1[0].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    descriptor_writes_1[0].pImageInfo      = &desc_image_1_info;
-
-    descriptor_writes_1[1].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptor_writes_1[1].dstBinding      = 1;
-    descriptor_writes_1[1].dstSet          = _descriptor_set_1_handle;
-    descriptor_writes_1[1].descriptorCount = 1;
-    descriptor_writes_1[1].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    descriptor_writes_1[1].pImageInfo      = &desc_image_0_info;
-
-    descriptor_writes_1[2].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptor_writes_1[2].dstBinding      = 2;
-    descriptor_writes_1[2].dstSet          = _descriptor_set_1_handle;
-    descriptor_writes_1[2].descriptorCount = 1;
-    descriptor_writes_1[2].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    descriptor_writes_1[2].pImageInfo      = &desc_image_2_info;
-
-    vkUpdateDescriptorSets(_device_handle, 3, descriptor_writes_1, 0, nullptr);
+        if (_config.pressure_solver == PressureSolver::FFT)
+            transition_image_layout(cmd_buff, _fft_spectrum_image._image_handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
 
-    _deletion_queue.enqueue_deletor(
-        [&](){
-            _global_descriptor_allocator.destroy_pool(_device_handle);
-            vkDestroyDescriptorSetLayout(_device_handle, _descriptor_set_layout_handle, nullptr);
+        if (_config.advection == AdvectionScheme::MACCORMACK)
+            transition_image_layout(cmd_buff, _maccormack_predicted_image._image_handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+
+        // Campi a zero: il primo solve della pressione parte da una soluzione valida
+        // invece che dal contenuto indefinito delle immagini (o da quello dell'autotuning)
+        for (int i = 0; i < 2; ++i)
+        {
+            clear_field_image(cmd_buff, _velocity_images[i]);
+            clear_field_image(cmd_buff, _pressure_images[i]);
         }
-    );
-}
 
-void Engine::run_jacobi_solver( VkCommandBuffer cmd_buff,
-                                VkPipeline jacobi_pipeline_handle,
-                                VkPipelineLayout jacobi_pipeline_layout_handle,
-                                const ComputePushConstants& pc,
-                                int iterations )
-{
-    // Variabili per alternare tra image0 e image1
-    bool toggle { false };
+        if (_restore_staging_buffer)
+            record_restore(cmd_buff);
 
-    for (int i = 0; i < iterations; ++i)
-    {
-        vkCmdBindPipeline(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, jacobi_pipeline_handle);
+        // Gli ostacoli sono statici: la maschera si rasterizza una volta sola
+        dispatch_compute(cmd_buff, _obstacles_pipeline_handle, _obstacles_pipeline_layout_handle, ComputePushConstants {});
+        compute_barrier(cmd_buff);
 
-        if (toggle)
-            vkCmdBindDescriptorSets(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, jacobi_pipeline_layout_handle, 0, 1, &_descriptor_set_0_handle, 0, nullptr);
-        else
-            vkCmdBindDescriptorSets(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, jacobi_pipeline_layout_handle, 0, 1, &_descriptor_set_1_handle, 0, nullptr);
+        _fields_initialized = { true };
+    }
 
-        vkCmdPushConstants(cmd_buff, jacobi_pipeline_layout_handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &pc);
-        vkCmdDispatch(cmd_buff, std::ceil(_draw_extent.width / 16.0), std::ceil(_draw_extent.height / 16.0), 1);
+    else
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            transition_image_layout(cmd_buff, _velocity_images[i]._image_handle, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+            transition_image_layout(cmd_buff, _pressure_images[i]._image_handle, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+        }
+    }
 
-        // Assicura che tutte le operazioni di scrittura siano completate prima della prossima iterazione
-        VkMemoryBarrier memory_barrier {};
-        memory_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
-        memory_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-        memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    //////////
 
-        vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+    compute_simulation_step(cmd_buff);
 
-        // Alterna tra imgA e imgB
-        toggle = !toggle;
-    }
+    _simulation_step_counter++;
 }
 
-void Engine::dispatch_compute(VkCommandBuffer cmd_buff, VkPipeline pipeline_handle, VkPipelineLayout pipeline_layout_handle, const ComputePushConstants& pc)
+void Engine::blit_to_swapchain(VkCommandBuffer cmd_buff, VkImage source, uint32_t swapchain_image_index)
 {
-    vkCmdBindPipeline(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_handle);
-    vkCmdBindDescriptorSets(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_handle, 0, 1, &_descriptor_set_0_handle, 0, nullptr);
-    vkCmdPushConstants(cmd_buff, pipeline_layout_handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &pc);
-    vkCmdDispatch(cmd_buff, std::ceil(_draw_extent.width / 16.0), std::ceil(_draw_extent.height / 16.0), 1);
+    // source deve già essere in TRANSFER_SRC_OPTIMAL
+    transition_image_layout(cmd_buff, _swapchain_image_handles[swapchain_image_index], VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    copy_image_to_image(cmd_buff, source, _swapchain_image_handles[swapchain_image_index], _draw_extent, _swapchain_extent);
+    transition_image_layout(cmd_buff, _swapchain_image_handles[swapchain_image_index], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
 }
 
-void Engine::compute_simulation_step(VkCommandBuffer cmd_buff)
+void Engine::wait_timeline(VkSemaphore timeline_handle, uint64_t value)
 {
-    ComputePushConstants pc {};
-    pc.mouse_down   = _input_handler.mouse_down;
-    pc.time_elapsed = (uint32_t) _stopwatch.elapsed();
-    pc.mouse_pos    = glm::ivec2(_input_handler.mouse_x, _input_handler.mouse_y);
+    VkSemaphoreWaitInfo wait_info {};
+    wait_info.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.pNext          = nullptr;
+    wait_info.flags          = 0;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores    = &timeline_handle;
+    wait_info.pValues        = &value;
+
+    result_check(vkWaitSemaphores(_device_handle, &wait_info, ONE_SECOND));
+}
 
-    // Assicura che tutte le operazioni di scrittura siano completate prima del prossimo step
-    VkMemoryBarrier memory_barrier {};
-    memory_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
-    memory_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-    memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+void Engine::submit_simulation_batch(uint32_t substeps)
+{
+    // Il command buffer di questo frame slot è stato usato dall'ultimo batch registrato qui:
+    // la grafica di quel frame può averne atteso solo uno precedente.
+    if (current_frame()._simulation_timeline_value > 0)
+        wait_timeline(_simulation_timeline_handle, current_frame()._simulation_timeline_value);
 
-    //LOG("Delta time: " + _stopwatch.elapsed_as_string(), COMPONENT_NAME);
+    consume_readback(current_frame()._pending_readback);
+    consume_residual_history(current_frame());
 
-    #define NUM_ITER 20
+    VkCommandBuffer compute_cmd_buff { current_frame()._compute_command_buffer_handle };
+    result_check(vkResetCommandBuffer(compute_cmd_buff, 0));
 
-    // diffusion
-    // pressure
+    VkCommandBufferBeginInfo cmd_buff_begin_info { vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) };
+    result_check(vkBeginCommandBuffer(compute_cmd_buff, &cmd_buff_begin_info));
+
+    _gpu_profiler.begin_frame(_device_handle, compute_cmd_buff, _frame_counter % FRAME_OVERLAP);
+
+    if (_gpu_profiler.enabled() && _frame_counter > 0 && _frame_counter % GpuProfiler::HISTORY_SIZE == 0)
+        LOG(_gpu_profiler.report(), COMPONENT_NAME);
+
+    for (uint32_t step = 0; step < substeps; ++step)
+        record_simulation_step(compute_cmd_buff);
+
+    record_due_readbacks(compute_cmd_buff);
+
+    uint64_t simulation_value { ++_simulation_timeline_value };
+    current_frame()._simulation_timeline_value = simulation_value;
+
+    const AllocatedImage& display_image { _display_images[simulation_value % 2] };
+
+    VkImageCopy copy_region {};
+    copy_region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    copy_region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    copy_region.extent         = { _draw_extent.width, _draw_extent.height, 1 };
+
+    transition_image_layout(compute_cmd_buff, _draw_image._image_handle, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    transition_image_layout(compute_cmd_buff, display_image._image_handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    vkCmdCopyImage(compute_cmd_buff, _draw_image._image_handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, display_image._image_handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_region);
+    transition_image_layout(compute_cmd_buff, display_image._image_handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+    result_check(vkEndCommandBuffer(compute_cmd_buff));
+
+    // Prima di sovrascrivere la display image attende l'ultimo frame che l'ha presentata
+    VkSemaphoreSubmitInfo wait_info { vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, _present_timeline_handle) };
+    wait_info.value = _display_image_present_values[simulation_value % 2];
+
+    VkSemaphoreSubmitInfo signal_info { vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, _simulation_timeline_handle) };
+    signal_info.value = simulation_value;
+
+    VkCommandBufferSubmitInfo cmd_buff_info { vkinit::command_buffer_submit_info(compute_cmd_buff) };
+    VkSubmitInfo2 submit { vkinit::submit_info(&cmd_buff_info, &signal_info, &wait_info) };
+    result_check(vkQueueSubmit2(_compute_queue_handle, 1, &submit, VK_NULL_HANDLE));
+}
+
+void Engine::draw_async()
+{
+    result_check(vkWaitForFences(_device_handle, 1, &current_frame()._render_fence_handle, true, ONE_SECOND));
+
+    current_frame()._deletion_queue.flush();
+
+    result_check(vkResetFences(_device_handle, 1, &current_frame()._render_fence_handle));
+
+    uint32_t swapchain_image_index {};
+    result_check(vkAcquireNextImageKHR(_device_handle, _swapchain_handle, ONE_SECOND, current_frame()._swapchain_semaphore_handle, nullptr, &swapchain_image_index));
+
+    _draw_extent.width  = _velocity_images[0]._image_extent.width;
+    _draw_extent.height = _velocity_images[0]._image_extent.height;
+
+    ////////// simulazione sulla coda di compute
+
+    // Senza step da simulare non si invia nessun batch: il frame ripresenta l'ultimo concluso
+    uint32_t substeps { simulation_substeps() };
+
+    if (substeps > 0)
+        submit_simulation_batch(substeps);
+
+    uint64_t simulation_value { _simulation_timeline_value };
+
+    ////////// presentazione sulla coda grafica
+
+    // Ultimo batch già concluso, senza attese; se è più vecchio del penultimo inviato si
+    // attende il penultimo: la sua display image è l'unica che nessun batch in volo sta scrivendo.
+    uint64_t completed_value {};
+    result_check(vkGetSemaphoreCounterValue(_device_handle, _simulation_timeline_handle, &completed_value));
+
+    uint64_t presented_value { std::max({ completed_value, simulation_value - 1, uint64_t { 1 } }) };
+    uint64_t present_value   { ++_present_timeline_value };
+
+    _display_image_present_values[presented_value % 2] = present_value;
+
+    VkCommandBuffer cmd_buff { current_frame()._command_buffer_handle };
+    result_check(vkResetCommandBuffer(cmd_buff, 0));
+
+    VkCommandBufferBeginInfo cmd_buff_begin_info { vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) };
+    result_check(vkBeginCommandBuffer(cmd_buff, &cmd_buff_begin_info));
+
+    blit_to_swapchain(cmd_buff, _display_images[presented_value % 2]._image_handle, swapchain_image_index);
+
+    result_check(vkEndCommandBuffer(cmd_buff));
+
+    std::array<VkSemaphoreSubmitInfo, 2> wait_infos
+    {
+        vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, current_frame()._swapchain_semaphore_handle),
+        vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, _simulation_timeline_handle)
+    };
+    wait_infos[1].value = presented_value;
+
+    std::array<VkSemaphoreSubmitInfo, 2> signal_infos
+    {
+        vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, current_frame()._render_semaphore_handle),
+        vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, _present_timeline_handle)
+    };
+    signal_infos[1].value = present_value;
+
+    VkCommandBufferSubmitInfo cmd_buff_info { vkinit::command_buffer_submit_info(cmd_buff) };
+
+    VkSubmitInfo2 submit { vkinit::submit_info(&cmd_buff_info, nullptr, nullptr) };
+    submit.waitSemaphoreInfoCount   = (uint32_t)wait_infos.size();
+    submit.pWaitSemaphoreInfos      = wait_infos.data();
+    submit.signalSemaphoreInfoCount = (uint32_t)signal_infos.size();
+    submit.pSignalSemaphoreInfos    = signal_infos.data();
+
+    result_check(vkQueueSubmit2(_graphics_queue_handle, 1, &submit, current_frame()._render_fence_handle));
+
+    VkPresentInfoKHR present_info {};
+    present_info.sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    present_info.pNext              = nullptr;
+    present_info.pSwapchains        = &_swapchain_handle;
+    present_info.swapchainCount     = 1;
+    present_info.pWaitSemaphores    = &current_frame()._render_semaphore_handle;
+    present_info.waitSemaphoreCount = 1;
+    present_info.pImageIndices      = &swapchain_image_index;
+
+    result_check(vkQueuePresentKHR(_graphics_queue_handle, &present_info));
+
+    _frame_counter++;
+}
+
+void Engine::init_snapshots()
+{
+    // Uno slot per frame in volo più uno in lettura sul thread del ring
+    if (!_config.checkpoint_path.empty() || !_config.export_path.empty())
+    {
+        _readback_ring.init(_allocator, image_size(_velocity_images[0]) + image_size(_pressure_images[0]), READBACK_SLOT_COUNT);
+        _deletion_queue.enqueue_deletor( [&]() { _readback_ring.destroy(); } );
+    }
+
+    if (_config.restore_path.empty())
+        return;
+
+    std::optional<Snapshot> snapshot { Snapshot::load(_config.restore_path) };
+
+    if (!snapshot)
+    {
+        #if DEBUG_LEVEL >= 1
+        LOG("Starting a new run instead of resuming.", COMPONENT_NAME, LogLevel::WARNING);
+        #endif
+        return;
+    }
+
+    const Snapshot::Header& header { snapshot->header };
+    const VkExtent3D        extent { _velocity_images[0]._image_extent };
+
+    VkDeviceSize velocity_size { image_size(_velocity_images[0]) };
+    VkDeviceSize pressure_size { image_size(_pressure_images[0]) };
+
+    bool compatible
+    {
+        header.width           == extent.width &&
+        header.height          == extent.height &&
+        header.velocity_format == (uint32_t)_velocity_images[0]._image_format &&
+        header.pressure_format == (uint32_t)_pressure_images[0]._image_format &&
+        header.velocity_size   == velocity_size &&
+        header.pressure_size   == pressure_size
+    };
+
+    if (!compatible)
+    {
+        #if DEBUG_LEVEL >= 1
+        LOG("Snapshot " + _config.restore_path.string() + " has a different grid or format, starting a new run.", COMPONENT_NAME, LogLevel::WARNING);
+        #endif
+        return;
+    }
+
+    #if DEBUG_LEVEL >= 1
+    if (header.delta_time != _config.fixed_delta_time)
+        LOG("Snapshot was simulated with dt " + std::to_string(header.delta_time) + "ms, resuming with " + std::to_string(_config.fixed_delta_time) + "ms.", COMPONENT_NAME, LogLevel::WARNING);
+    #endif
+
+    // Il caricamento vero e proprio avviene nel primo step, insieme alla transizione dei campi
+    AllocatedBuffer staging_buffer { create_buffer(velocity_size + pressure_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT) };
+
+    char* staging_data { (char*)staging_buffer._allocation_info.pMappedData };
+    std::memcpy(staging_data, snapshot->velocity.data(), velocity_size);
+    std::memcpy(staging_data + velocity_size, snapshot->pressure.data(), pressure_size);
+    vmaFlushAllocation(_allocator, staging_buffer._allocation, 0, VK_WHOLE_SIZE);
+
+    _restore_staging_buffer  = { staging_buffer };
+    _simulation_step_counter = { header.step_count };
+    _last_checkpoint_step    = { header.step_count };
+    _last_export_step        = { header.step_count };
+
+    #if DEBUG_LEVEL >= 1
+    LOG("Resuming from step " + std::to_string(header.step_count) + " of " + _config.restore_path.string() + ".", COMPONENT_NAME);
+    #endif
+}
+
+void Engine::record_restore(VkCommandBuffer cmd_buff)
+{
+    // All'inizio _velocity_index e _pressure_index valgono 0
+    VkBufferImageCopy velocity_region {};
+    velocity_region.bufferOffset     = 0;
+    velocity_region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    velocity_region.imageExtent      = _velocity_images[0]._image_extent;
+
+    // Nel buffer la pressione segue la velocità
+    VkBufferImageCopy pressure_region { velocity_region };
+    pressure_region.bufferOffset = image_size(_velocity_images[0]);
+
+    vkCmdCopyBufferToImage(cmd_buff, _restore_staging_buffer->_buffer_handle, _velocity_images[0]._image_handle, VK_IMAGE_LAYOUT_GENERAL, 1, &velocity_region);
+    vkCmdCopyBufferToImage(cmd_buff, _restore_staging_buffer->_buffer_handle, _pressure_images[0]._image_handle, VK_IMAGE_LAYOUT_GENERAL, 1, &pressure_region);
+
+    transition_image_layout(cmd_buff, _velocity_images[0]._image_handle, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+    transition_image_layout(cmd_buff, _pressure_images[0]._image_handle, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+
+    // Il buffer si libera quando questo frame slot viene riusato: anche con il compute
+    // asincrono la grafica del primo frame attende il primo batch
+    AllocatedBuffer staging_buffer { *_restore_staging_buffer };
+    current_frame()._deletion_queue.enqueue_deletor( [this, staging_buffer]() { destroy_buffer(staging_buffer); } );
+
+    _restore_staging_buffer.reset();
+}
+
+bool Engine::checkpoint_due() const
+{
+    return !_config.checkpoint_path.empty()
+        && _config.checkpoint_interval > 0
+        && _simulation_step_counter >= _last_checkpoint_step + _config.checkpoint_interval;
+}
+
+bool Engine::export_due() const
+{
+    return !_config.export_path.empty()
+        && _simulation_step_counter >= _last_export_step + _config.export_interval;
+}
+
+void Engine::record_due_readbacks(VkCommandBuffer cmd_buff)
+{
+    bool checkpoint { checkpoint_due() };
+    bool field_export { export_due() };
+
+    // Checkpoint ed export dello stesso step condividono la stessa copia
+    if (checkpoint || field_export)
+        current_frame()._pending_readback = { record_readback(cmd_buff, checkpoint, field_export) };
+}
+
+std::optional<Engine::PendingReadback> Engine::record_readback(VkCommandBuffer cmd_buff, bool checkpoint, bool field_export)
+{
+    std::optional<uint32_t> slot { _readback_ring.acquire() };
+
+    // Tutti gli slot sono ancora in volo: meglio saltare una lettura che fermare il frame
+    if (!slot)
+    {
+        #if DEBUG_LEVEL >= 1
+        LOG("Readback ring full, fields of step " + std::to_string(_simulation_step_counter) + " skipped.", COMPONENT_NAME, LogLevel::WARNING);
+        #endif
+        return std::nullopt;
+    }
+
+    const VkExtent3D extent { _velocity_images[0]._image_extent };
+
+    Snapshot::Header header {};
+    header.magic           = { Snapshot::FILE_MAGIC };
+    header.version         = { Snapshot::FILE_VERSION };
+    header.width           = { extent.width };
+    header.height          = { extent.height };
+    header.velocity_format = { (uint32_t)_velocity_images[0]._image_format };
+    header.pressure_format = { (uint32_t)_pressure_images[0]._image_format };
+    header.step_count      = { _simulation_step_counter };
+    header.delta_time      = { _config.fixed_delta_time };
+    header.velocity_size   = { image_size(_velocity_images[0]) };
+    header.pressure_size   = { image_size(_pressure_images[0]) };
+
+    const AllocatedImage& velocity_image { _velocity_images[_velocity_index] };
+    const AllocatedImage& pressure_image { _pressure_images[_pressure_index] };
+
+    // Le scritture dell'ultimo pass devono essere concluse prima della copia
+    transition_image_layout(cmd_buff, velocity_image._image_handle, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+    transition_image_layout(cmd_buff, pressure_image._image_handle, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+
+    VkBufferImageCopy velocity_region {};
+    velocity_region.bufferOffset     = 0;
+    velocity_region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    velocity_region.imageExtent      = velocity_image._image_extent;
+
+    VkBufferImageCopy pressure_region { velocity_region };
+    pressure_region.bufferOffset = header.velocity_size;
+
+    vkCmdCopyImageToBuffer(cmd_buff, velocity_image._image_handle, VK_IMAGE_LAYOUT_GENERAL, _readback_ring.buffer(*slot), 1, &velocity_region);
+    vkCmdCopyImageToBuffer(cmd_buff, pressure_image._image_handle, VK_IMAGE_LAYOUT_GENERAL, _readback_ring.buffer(*slot), 1, &pressure_region);
+
+    // Rende la copia visibile all'host dopo l'attesa del fence (o della timeline)
+    VkMemoryBarrier2 host_barrier {};
+    host_barrier.sType         = { VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+    host_barrier.pNext         = { nullptr };
+    host_barrier.srcStageMask  = { VK_PIPELINE_STAGE_2_TRANSFER_BIT };
+    host_barrier.srcAccessMask = { VK_ACCESS_2_TRANSFER_WRITE_BIT };
+    host_barrier.dstStageMask  = { VK_PIPELINE_STAGE_2_HOST_BIT };
+    host_barrier.dstAccessMask = { VK_ACCESS_2_HOST_READ_BIT };
+
+    VkDependencyInfo dep_info {};
+    dep_info.sType              = { VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+    dep_info.pNext              = { nullptr };
+    dep_info.memoryBarrierCount = { 1 };
+    dep_info.pMemoryBarriers    = { &host_barrier };
+
+    vkCmdPipelineBarrier2(cmd_buff, &dep_info);
+
+    std::filesystem::path checkpoint_path {};
+    std::filesystem::path export_path     {};
+
+    if (checkpoint)
+    {
+        checkpoint_path       = { _config.checkpoint_path };
+        _last_checkpoint_step = { _simulation_step_counter };
+    }
+
+    if (field_export)
+    {
+        export_path       = { Snapshot::export_file_path(_config.export_path, _simulation_step_counter) };
+        _last_export_step = { _simulation_step_counter };
+    }
+
+    // Eseguito dal thread del ring, FRAME_OVERLAP frame dopo: i dati sono già nel buffer mappato
+    ReadbackRing::Consumer consumer
+    {
+        [header, checkpoint_path, export_path](std::span<const char> data)
+        {
+            std::span<const char> velocity { data.subspan(0, header.velocity_size) };
+            std::span<const char> pressure { data.subspan(header.velocity_size, header.pressure_size) };
+
+            if (!checkpoint_path.empty())
+                Snapshot::write(checkpoint_path, header, velocity, pressure);
+
+            if (!export_path.empty())
+                Snapshot::write(export_path, header, velocity, pressure);
+        }
+    };
+
+    return PendingReadback { ._slot = *slot, ._consumer = std::move(consumer) };
+}
+
+void Engine::consume_readback(std::optional<PendingReadback>& pending_readback)
+{
+    if (!pending_readback)
+        return;
+
+    _readback_ring.consume(pending_readback->_slot, std::move(pending_readback->_consumer));
+    pending_readback.reset();
+}
+
+void Engine::finish_readbacks()
+{
+    // Prima le letture ancora in volo, poi lo stato finale: il ring le consuma in ordine
+    vkDeviceWaitIdle(_device_handle);
+
+    for (Frame& frame : _frames)
+        consume_readback(frame._pending_readback);
+
+    if (!_config.checkpoint_path.empty() && _fields_initialized && _simulation_step_counter != _last_checkpoint_step)
+    {
+        // Con il ring vuoto c'è sempre uno slot libero
+        _readback_ring.wait_idle();
+
+        std::optional<PendingReadback> readback {};
+        immediate_submit([&](VkCommandBuffer cmd_buff) { readback = record_readback(cmd_buff, true, false); });
+
+        consume_readback(readback);
+    }
+
+    _readback_ring.wait_idle();
+}
+
+void Engine::init_pipeline_cache()
+{
+    // Senza file la cache resta comunque valida (vuota) per vkCreateComputePipelines
+    std::filesystem::path cache_path { _config.pipeline_cache_path };
+
+    if (!cache_path.empty() && cache_path.is_relative())
+        cache_path = { std::filesystem::current_path() / cache_path };
+
+    _pipeline_cache.init(_device_handle, _physical_device_handle, cache_path);
+    _deletion_queue.enqueue_deletor( [&]() { _pipeline_cache.destroy(_device_handle); } );
+}
+
+void Engine::init_workgroup_size()
+{
+    _workgroup_size = { _config.workgroup_width, _config.workgroup_height };
+
+    VkPhysicalDeviceProperties properties {};
+    vkGetPhysicalDeviceProperties(_physical_device_handle, &properties);
+
+    const VkPhysicalDeviceLimits& limits { properties.limits };
+
+    bool supported
+    {
+        _workgroup_size.width  <= limits.maxComputeWorkGroupSize[0] &&
+        _workgroup_size.height <= limits.maxComputeWorkGroupSize[1] &&
+        _workgroup_size.width * _workgroup_size.height <= limits.maxComputeWorkGroupInvocations
+    };
+
+    if (!supported)
+    {
+        #if DEBUG_LEVEL >= 1
+        LOG("Workgroup " + std::to_string(_workgroup_size.width) + "x" + std::to_string(_workgroup_size.height) + " exceeds the device limits, using 16x16.", COMPONENT_NAME, LogLevel::WARNING);
+        #endif
+
+        _workgroup_size = { 16, 16 };
+    }
+}
+
+void Engine::init_pipelines()
+{
+    init_workgroup_size();
+
+    std::filesystem::path tuning_path { _config.workgroup_tuning_path };
+
+    if (!tuning_path.empty() && tuning_path.is_relative())
+        tuning_path = { std::filesystem::current_path() / tuning_path };
+
+    _workgroup_tuning.init(_physical_device_handle, tuning_path, { _config.grid_width, _config.grid_height }, _config.half_precision);
+
+    // I kernel misurati dall'autotuner partono dalla dimensione salvata, se c'è
+    init_compute_pipeline(_advection_pipeline_handle, _advection_pipeline_layout_handle, field_shader_path("advection"), kernel_workgroup_size("advection"));
+    init_compute_pipeline(_jacobi_diffusion_pipeline_handle, _jacobi_diffusion_pipeline_layout_handle, field_shader_path("jacobi_diffusion"), kernel_workgroup_size("jacobi_diffusion"));
+    init_compute_pipeline(_jacobi_pressure_pipeline_handle, _jacobi_pressure_pipeline_layout_handle, field_shader_path("jacobi_pressure"), kernel_workgroup_size("jacobi_pressure"));
+    init_compute_pipeline(_remove_divergency_pipeline_handle, _remove_divergency_pipeline_layout_handle, field_shader_path("remove_divergency"), kernel_workgroup_size("remove_divergency"));
+    init_compute_pipeline(_obstacles_pipeline_handle, _obstacles_pipeline_layout_handle, field_shader_path("obstacles"));
+
+    if (_config.jacobi_block_iterations > 1)
+    {
+        init_compute_pipeline(_jacobi_diffusion_tiled_pipeline_handle, _jacobi_diffusion_tiled_pipeline_layout_handle, field_shader_path("jacobi_diffusion_tiled"), TILED_WORKGROUP_SIZE);
+        init_compute_pipeline(_jacobi_pressure_tiled_pipeline_handle, _jacobi_pressure_tiled_pipeline_layout_handle, field_shader_path("jacobi_pressure_tiled"), TILED_WORKGROUP_SIZE);
+    }
+
+    if (_config.pressure_solver == PressureSolver::SOR)
+        init_compute_pipeline(_sor_pressure_pipeline_handle, _sor_pressure_pipeline_layout_handle, field_shader_path("sor_pressure"), { &_descriptor_set_layout_handle, 1 }, sizeof(SorPushConstants));
+
+    if (_config.autotune_workgroups)
+        autotune_workgroups();
+}
+
+void Engine::init_compute_pipeline(VkPipeline& pipeline_handle, VkPipelineLayout& pipeline_layout_handle, const std::string& spv_path, std::optional<VkExtent2D> workgroup_size)
+{
+    init_compute_pipeline(pipeline_handle, pipeline_layout_handle, spv_path, { &_descriptor_set_layout_handle, 1 }, sizeof(ComputePushConstants), workgroup_size);
+}
+
+void Engine::init_compute_pipeline( VkPipeline& pipeline_handle,
+                                    VkPipelineLayout& pipeline_layout_handle,
+                                    const std::string& spv_path,
+                                    std::span<const VkDescriptorSetLayout> descriptor_set_layouts,
+                                    uint32_t push_constants_size,
+                                    std::optional<VkExtent2D> workgroup_size )
+{
+    VkPushConstantRange push_constant_range {};
+    push_constant_range.offset     = 0;
+    push_constant_range.size       = push_constants_size;
+    push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info {};
+    pipeline_layout_create_info.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_create_info.pNext                  = nullptr;
+    pipeline_layout_create_info.pSetLayouts            = descriptor_set_layouts.data();
+    pipeline_layout_create_info.setLayoutCount         = (uint32_t)descriptor_set_layouts.size();
+    pipeline_layout_create_info.pPushConstantRanges    = &push_constant_range;
+    pipeline_layout_create_info.pushConstantRangeCount = 1;
+
+    result_check(vkCreatePipelineLayout(_device_handle, &pipeline_layout_create_info, nullptr, &pipeline_layout_handle));
+
+    pipeline_handle = { create_compute_pipeline(pipeline_layout_handle, spv_path, workgroup_size.value_or(_workgroup_size)) };
+
+    _deletion_queue.enqueue_deletor(
+        [&]() {
+            vkDestroyPipelineLayout(_device_handle, pipeline_layout_handle, nullptr);
+            vkDestroyPipeline(_device_handle, pipeline_handle, nullptr);
+        }
+    );
+}
+
+VkPipeline Engine::create_compute_pipeline(VkPipelineLayout pipeline_layout_handle, const std::string& spv_path, VkExtent2D workgroup_size)
+{
+    VkShaderModule shader_module {};
+
+    if (!load_shader_module(spv_path, shader_module))
+    {
+        #if DEBUG_LEVEL >= 1
+        LOG("Error when building the compute shader.", COMPONENT_NAME);
+        #endif
+    }
+
+    // Dimensione del workgroup e parametri della simulazione come costanti: il driver li ripiega nel codice
+    SpecializationConstants specialization_constants {};
+    specialization_constants.workgroup_size_x = { workgroup_size.width };
+    specialization_constants.workgroup_size_y = { workgroup_size.height };
+    specialization_constants.diffusion_rate   = { DIFFUSION_RATE };
+    specialization_constants.boundary_cells   = { BOUNDARY_CELLS };
+    specialization_constants.sor_omega          = { _config.sor_omega };
+    specialization_constants.pcg_preconditioner = { (uint32_t)_config.pcg_preconditioner };
+    std::memcpy(specialization_constants.obstacle_spheres, OBSTACLE_SPHERES, sizeof(OBSTACLE_SPHERES));
+
+    // Senza ostacoli la maschera resta vuota: sfere di raggio nullo e nessuna cella di bordo
+    if (!_config.obstacles)
+    {
+        for (float (&sphere)[3] : specialization_constants.obstacle_spheres)
+            sphere[2] = { 0.0f };
+
+        specialization_constants.boundary_cells = { -1 };
+    }
+
+    std::array<VkSpecializationMapEntry, SPECIALIZATION_CONSTANT_COUNT> specialization_entries {};
+
+    for (uint32_t i = 0; i < SPECIALIZATION_CONSTANT_COUNT; ++i)
+        specialization_entries[i] = { .constantID = i, .offset = i * (uint32_t)sizeof(uint32_t), .size = sizeof(uint32_t) };
+
+    VkSpecializationInfo specialization_info {};
+    specialization_info.mapEntryCount = (uint32_t)specialization_entries.size();
+    specialization_info.pMapEntries   = specialization_entries.data();
+    specialization_info.dataSize      = sizeof(SpecializationConstants);
+    specialization_info.pData         = &specialization_constants;
+
+    VkPipelineShaderStageCreateInfo pipeline_shader_stage_create_info {};
+    pipeline_shader_stage_create_info.sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_shader_stage_create_info.pNext               = nullptr;
+    pipeline_shader_stage_create_info.stage               = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_shader_stage_create_info.module              = shader_module;
+    pipeline_shader_stage_create_info.pName               = "main";
+    pipeline_shader_stage_create_info.pSpecializationInfo = &specialization_info;
+
+    VkComputePipelineCreateInfo compute_pipeline_create_info{};
+    compute_pipeline_create_info.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    compute_pipeline_create_info.pNext  = nullptr;
+    compute_pipeline_create_info.layout = pipeline_layout_handle;
+    compute_pipeline_create_info.stage  = pipeline_shader_stage_create_info;
+
+    VkPipeline pipeline_handle {};
+    result_check(vkCreateComputePipelines(_device_handle, _pipeline_cache.handle(), 1, &compute_pipeline_create_info, nullptr, &pipeline_handle));
+
+    vkDestroyShaderModule(_device_handle, shader_module, nullptr);
+
+    // Usata da dispatch_grid() per il numero di workgroup di ogni dispatch
+    _pipeline_workgroup_sizes[pipeline_handle] = { workgroup_size };
+
+    return pipeline_handle;
+}
+
+VkExtent2D Engine::pipeline_workgroup_size(VkPipeline pipeline_handle) const
+{
+    auto size_it = _pipeline_workgroup_sizes.find(pipeline_handle);
+
+    return size_it != _pipeline_workgroup_sizes.end() ? size_it->second : _workgroup_size;
+}
+
+VkExtent2D Engine::kernel_workgroup_size(const std::string& kernel_name) const
+{
+    return _workgroup_tuning.find(kernel_name).value_or(_workgroup_size);
+}
+
+void Engine::autotune_workgroups()
+{
+    uint32_t family_count {};
+    vkGetPhysicalDeviceQueueFamilyProperties(_physical_device_handle, &family_count, nullptr);
+
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(_physical_device_handle, &family_count, families.data());
+
+    uint32_t valid_bits { families[_compute_queue_family].timestampValidBits };
+
+    if (valid_bits == 0)
+    {
+        #if DEBUG_LEVEL >= 1
+        LOG("The compute queue does not support timestamps, workgroup autotuning skipped.", COMPONENT_NAME, LogLevel::WARNING);
+        #endif
+        return;
+    }
+
+    VkPhysicalDeviceProperties properties {};
+    vkGetPhysicalDeviceProperties(_physical_device_handle, &properties);
+
+    const VkPhysicalDeviceLimits& limits { properties.limits };
+
+    uint64_t timestamp_mask { valid_bits >= 64 ? ~uint64_t {} : (uint64_t { 1 } << valid_bits) - 1 };
+
+    VkQueryPoolCreateInfo query_pool_create_info {};
+    query_pool_create_info.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    query_pool_create_info.pNext      = nullptr;
+    query_pool_create_info.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+    query_pool_create_info.queryCount = 2;
+
+    VkQueryPool query_pool_handle {};
+    result_check(vkCreateQueryPool(_device_handle, &query_pool_create_info, nullptr, &query_pool_handle));
+
+    // I kernel leggono e scrivono i campi: il contenuto non conta, basta che siano in GENERAL.
+    // Al primo frame vengono comunque ripresi da UNDEFINED e inizializzati.
+    immediate_submit([&](VkCommandBuffer cmd_buff)
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            transition_image_layout(cmd_buff, _velocity_images[i]._image_handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+            transition_image_layout(cmd_buff, _pressure_images[i]._image_handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+        }
+
+        transition_image_layout(cmd_buff, _draw_image._image_handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+        transition_image_layout(cmd_buff, _obstacle_image._image_handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    });
+
+    struct TunedKernel
+    {
+        std::string       _name                   {};
+        VkPipeline&       _pipeline_handle;
+        VkPipelineLayout  _pipeline_layout_handle {};
+    };
+
+    std::array<TunedKernel, 4> kernels
+    {{
+        { "advection",         _advection_pipeline_handle,         _advection_pipeline_layout_handle         },
+        { "jacobi_diffusion",  _jacobi_diffusion_pipeline_handle,  _jacobi_diffusion_pipeline_layout_handle  },
+        { "jacobi_pressure",   _jacobi_pressure_pipeline_handle,   _jacobi_pressure_pipeline_layout_handle   },
+        { "remove_divergency", _remove_divergency_pipeline_handle, _remove_divergency_pipeline_layout_handle },
+    }};
+
+    const VkExtent3D field_extent { _velocity_images[0]._image_extent };
+
+    ComputePushConstants pc {};
+    pc.delta_time = { _config.fixed_delta_time };
+
+    for (TunedKernel& kernel : kernels)
+    {
+        std::optional<VkExtent2D> best_size {};
+        double                    best_us   {};
+
+        for (VkExtent2D candidate : WORKGROUP_CANDIDATES)
+        {
+            if (candidate.width  > limits.maxComputeWorkGroupSize[0] ||
+                candidate.height > limits.maxComputeWorkGroupSize[1] ||
+                candidate.width * candidate.height > limits.maxComputeWorkGroupInvocations)
+                continue;
+
+            VkPipeline candidate_pipeline_handle { create_compute_pipeline(kernel._pipeline_layout_handle, field_shader_path(kernel._name), candidate) };
+            VkDescriptorSet descriptor_set_handle { field_descriptor_set() };
+
+            // Un dispatch di riscaldamento, poi TUNING_DISPATCHES dispatch fra i due timestamp
+            immediate_submit([&](VkCommandBuffer cmd_buff)
+            {
+                vkCmdResetQueryPool(cmd_buff, query_pool_handle, 0, 2);
+
+                vkCmdBindPipeline(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, candidate_pipeline_handle);
+                vkCmdBindDescriptorSets(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, kernel._pipeline_layout_handle, 0, 1, &descriptor_set_handle, 0, nullptr);
+                vkCmdPushConstants(cmd_buff, kernel._pipeline_layout_handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &pc);
+
+                dispatch_grid(cmd_buff, { field_extent.width, field_extent.height }, candidate);
+                compute_barrier(cmd_buff);
+
+                vkCmdWriteTimestamp2(cmd_buff, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, query_pool_handle, 0);
+
+                for (uint32_t i = 0; i < TUNING_DISPATCHES; ++i)
+                {
+                    dispatch_grid(cmd_buff, { field_extent.width, field_extent.height }, candidate);
+                    compute_barrier(cmd_buff);
+                }
+
+                vkCmdWriteTimestamp2(cmd_buff, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, query_pool_handle, 1);
+            });
+
+            uint64_t timestamps[2] {};
+            result_check(vkGetQueryPoolResults(_device_handle, query_pool_handle, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+            double duration_us { ((timestamps[1] - timestamps[0]) & timestamp_mask) * (double)limits.timestampPeriod / 1000.0 / TUNING_DISPATCHES };
+
+            _pipeline_workgroup_sizes.erase(candidate_pipeline_handle);
+            vkDestroyPipeline(_device_handle, candidate_pipeline_handle, nullptr);
+
+            if (!best_size || duration_us < best_us)
+            {
+                best_size = { candidate };
+                best_us   = { duration_us };
+            }
+        }
+
+        if (!best_size)
+            continue;
+
+        #if DEBUG_LEVEL >= 1
+        LOG("Fastest workgroup for " + kernel._name + ": " + std::to_string(best_size->width) + "x" + std::to_string(best_size->height) + " (" + std::to_string(best_us) + " us per dispatch).", COMPONENT_NAME);
+        #endif
+
+        _workgroup_tuning.set(kernel._name, *best_size);
+
+        // Il deletor registrato da init_compute_pipeline distrugge l'handle attuale del membro
+        VkExtent2D current_size { pipeline_workgroup_size(kernel._pipeline_handle) };
+
+        if (current_size.width != best_size->width || current_size.height != best_size->height)
+        {
+            _pipeline_workgroup_sizes.erase(kernel._pipeline_handle);
+            vkDestroyPipeline(_device_handle, kernel._pipeline_handle, nullptr);
+
+            kernel._pipeline_handle = { create_compute_pipeline(kernel._pipeline_layout_handle, field_shader_path(kernel._name), *best_size) };
+        }
+    }
+
+    vkDestroyQueryPool(_device_handle, query_pool_handle, nullptr);
+
+    _workgroup_tuning.save();
+}
+
+void Engine::init_descriptor_sets()
+{
+    // binding 0-1: velocità (current, next), 2-3: pressione (current, next),
+    // 4: immagine, 5: maschera degli ostacoli
+    constexpr uint32_t binding_count { 6 };
+
+    std::vector<DescriptorAllocator::PoolSizeRatio> sizes =
+    {
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, static_cast<float>(binding_count) }
+    };
+
+    _global_descriptor_allocator.init_pool(_device_handle, 10, sizes);
+
+    DescriptorLayoutBuilder layout_builder {};
+
+    for (uint32_t i {}; i < binding_count; ++i)
+    {
+        layout_builder.add_binding(i, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    }
+
+    _descriptor_set_layout_handle = layout_builder.build(_device_handle, VK_SHADER_STAGE_COMPUTE_BIT);
+
+    // Un set per ogni combinazione dei due ping-pong: i solver iterano su uno
+    // dei due campi lasciando l'altro fermo sull'immagine aggiornata.
+    DescriptorWriter writer {};
+
+    for (int velocity = 0; velocity < 2; ++velocity)
+    {
+        for (int pressure = 0; pressure < 2; ++pressure)
+        {
+            VkDescriptorSet& set { _descriptor_set_handles[velocity][pressure] };
+            set = _global_descriptor_allocator.allocate(_device_handle, _descriptor_set_layout_handle);
+
+            writer.clear();
+            writer.write_image(0, _velocity_images[velocity]._image_view_handle, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+            writer.write_image(1, _velocity_images[1 - velocity]._image_view_handle, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+            writer.write_image(2, _pressure_images[pressure]._image_view_handle, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+            writer.write_image(3, _pressure_images[1 - pressure]._image_view_handle, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+            writer.write_image(4, _draw_image._image_view_handle, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+            writer.write_image(5, _obstacle_image._image_view_handle, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+            writer.update_set(_device_handle, set);
+        }
+    }
+
+    _deletion_queue.enqueue_deletor(
+        [&](){
+            _global_descriptor_allocator.destroy_pool(_device_handle);
+            vkDestroyDescriptorSetLayout(_device_handle, _descriptor_set_layout_handle, nullptr);
+        }
+    );
+}
+
+void Engine::run_jacobi_diffusion(VkCommandBuffer cmd_buff, const ComputePushConstants& pc, int iterations)
+{
+    // Ping-pong della sola velocità, la pressione resta ferma
+    std::array<VkDescriptorSet, 2> ping_pong_sets
+    {
+        _descriptor_set_handles[_velocity_index][_pressure_index],
+        _descriptor_set_handles[1 - _velocity_index][_pressure_index]
+    };
+
+    int dispatches {};
+
+    if (_config.jacobi_block_iterations > 1)
+        dispatches = run_jacobi_solver(cmd_buff, _jacobi_diffusion_tiled_pipeline_handle, _jacobi_diffusion_tiled_pipeline_layout_handle, ping_pong_sets, pc, iterations, _config.jacobi_block_iterations);
+    else
+        dispatches = run_jacobi_solver(cmd_buff, _jacobi_diffusion_pipeline_handle, _jacobi_diffusion_pipeline_layout_handle, ping_pong_sets, pc, iterations);
+
+    _velocity_index ^= dispatches % 2;
+}
+
+void Engine::run_jacobi_pressure(VkCommandBuffer cmd_buff, const ComputePushConstants& pc, int iterations, std::optional<uint32_t> solve_index)
+{
+    // Ping-pong della sola pressione, la divergenza si legge dalla velocità corrente
+    std::array<VkDescriptorSet, 2> ping_pong_sets
+    {
+        _descriptor_set_handles[_velocity_index][_pressure_index],
+        _descriptor_set_handles[_velocity_index][1 - _pressure_index]
+    };
+
+    // Lo storico del residuo riguarda solo i solve completi, non lo smoothing del multigrid
+    std::optional<uint32_t> history_offset {};
+
+    if (_residual_history && solve_index)
+        history_offset = { residual_history_offset(*solve_index) };
+
+    int dispatches {};
+
+    if (_config.jacobi_block_iterations > 1)
+        dispatches = run_jacobi_solver(cmd_buff, _jacobi_pressure_tiled_pipeline_handle, _jacobi_pressure_tiled_pipeline_layout_handle, ping_pong_sets, pc, iterations, _config.jacobi_block_iterations, _residual_checks, history_offset);
+    else
+        dispatches = run_jacobi_solver(cmd_buff, _jacobi_pressure_pipeline_handle, _jacobi_pressure_pipeline_layout_handle, ping_pong_sets, pc, iterations, 1, _residual_checks, history_offset);
+
+    _pressure_index ^= dispatches % 2;
+}
+
+int Engine::run_jacobi_solver( VkCommandBuffer cmd_buff,
+                               VkPipeline jacobi_pipeline_handle,
+                               VkPipelineLayout jacobi_pipeline_layout_handle,
+                               std::span<const VkDescriptorSet, 2> ping_pong_sets,
+                               const ComputePushConstants& pc,
+                               int iterations,
+                               uint32_t block_iterations,
+                               bool residual_checks,
+                               std::optional<uint32_t> history_offset )
+{
+    // Con i kernel a blocchi ogni dispatch esegue fino a block_iterations iterazioni.
+    // Restituisce il numero di dispatch: se è dispari il risultato si trova
+    // nell'immagine *_next del primo set.
+    int dispatches { (iterations + (int)block_iterations - 1) / (int)block_iterations };
+
+    ComputePushConstants block_pc { pc };
+
+    VkExtent2D workgroup_size { pipeline_workgroup_size(jacobi_pipeline_handle) };
+
+    if (residual_checks || history_offset)
+        reset_residual_state(cmd_buff, workgroup_size, history_offset.value_or(NO_RESIDUAL_HISTORY));
+
+    // Voce 0 dello storico: il residuo della soluzione di partenza
+    if (history_offset)
+        record_residual(cmd_buff, ping_pong_sets[0], *history_offset);
+
+    for (int i = 0; i < dispatches; ++i)
+    {
+        // Dopo un controllo le iterazioni rimaste si saltano tutte insieme: controllando
+        // solo quando ne resta un numero pari, il risultato finisce comunque nell'immagine
+        // prevista dal chiamante, che inverte il ping-pong in base a dispatches.
+        if (residual_checks && i > 0 && i % (int)_config.residual_check_interval == 0 && (dispatches - i) % 2 == 0)
+            record_residual_check(cmd_buff, ping_pong_sets[i % 2]);
+
+        block_pc.block_iterations = (uint32_t)(iterations / dispatches + (i < iterations % dispatches ? 1 : 0));
+
+        vkCmdBindPipeline(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, jacobi_pipeline_handle);
+
+        // Alterna tra i due set: il secondo legge ciò che ha scritto il primo
+        vkCmdBindDescriptorSets(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, jacobi_pipeline_layout_handle, 0, 1, &ping_pong_sets[i % 2], 0, nullptr);
+
+        vkCmdPushConstants(cmd_buff, jacobi_pipeline_layout_handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &block_pc);
+
+        if (residual_checks)
+            vkCmdDispatchIndirect(cmd_buff, _residual_buffer._buffer_handle, offsetof(ResidualState, dispatch));
+        else
+            dispatch_grid(cmd_buff, _draw_extent, workgroup_size);
+
+        // Assicura che tutte le operazioni di scrittura siano completate prima della prossima iterazione
+        VkMemoryBarrier memory_barrier {};
+        memory_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memory_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+
+        // Il risultato del dispatch i è l'immagine corrente del set successivo
+        if (history_offset && i + 1 < (int)MAX_RESIDUAL_HISTORY)
+            record_residual(cmd_buff, ping_pong_sets[(i + 1) % 2], *history_offset + i + 1);
+    }
+
+    return dispatches;
+}
+
+void Engine::init_residual_checks()
+{
+    // jacobi_residual.comp riduce il residuo con subgroupMax()
+    VkPhysicalDeviceSubgroupProperties subgroup_properties {};
+    subgroup_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &subgroup_properties;
+
+    vkGetPhysicalDeviceProperties2(_physical_device_handle, &properties);
+
+    if (!(subgroup_properties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) || !(subgroup_properties.supportedOperations & VK_SUBGROUP_FEATURE_ARITHMETIC_BIT))
+    {
+        #if DEBUG_LEVEL >= 1
+        LOG("The device lacks subgroup arithmetic in compute shaders, --pressure-tolerance and --log-residuals ignored.", COMPONENT_NAME, LogLevel::WARNING);
+        #endif
+        return;
+    }
+
+    VkBufferUsageFlags buffer_usages { VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT };
+
+    _residual_buffer = { create_buffer(sizeof(ResidualState), buffer_usages, 0) };
+
+    // jacobi_residual.comp dichiara sempre lo storico: il buffer esiste anche senza --log-residuals
+    VkDeviceSize history_size { FRAME_OVERLAP * PRESSURE_SOLVES_PER_STEP * MAX_RESIDUAL_HISTORY * sizeof(uint32_t) };
+
+    _residual_history_buffer = { create_buffer(history_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT) };
+
+    std::vector<DescriptorAllocator::PoolSizeRatio> sizes =
+    {
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f }
+    };
+
+    _residual_descriptor_allocator.init_pool(_device_handle, 1, sizes);
+
+    DescriptorLayoutBuilder layout_builder {};
+    layout_builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    layout_builder.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+
+    _residual_descriptor_set_layout_handle = layout_builder.build(_device_handle, VK_SHADER_STAGE_COMPUTE_BIT);
+    _residual_descriptor_set_handle        = _residual_descriptor_allocator.allocate(_device_handle, _residual_descriptor_set_layout_handle);
+
+    DescriptorWriter writer {};
+    writer.write_buffer(0, _residual_buffer._buffer_handle, sizeof(ResidualState), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    writer.write_buffer(1, _residual_history_buffer._buffer_handle, history_size, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    writer.update_set(_device_handle, _residual_descriptor_set_handle);
+
+    _deletion_queue.enqueue_deletor(
+        [&](){
+            _residual_descriptor_allocator.destroy_pool(_device_handle);
+            vkDestroyDescriptorSetLayout(_device_handle, _residual_descriptor_set_layout_handle, nullptr);
+            destroy_buffer(_residual_buffer);
+            destroy_buffer(_residual_history_buffer);
+        }
+    );
+
+    // Layout: campi (set 0) + stato del controllo (set 1)
+    std::array<VkDescriptorSetLayout, 2> residual_layouts { _descriptor_set_layout_handle, _residual_descriptor_set_layout_handle };
+
+    init_compute_pipeline(_jacobi_residual_pipeline_handle, _jacobi_residual_pipeline_layout_handle, field_shader_path("jacobi_residual"), residual_layouts, sizeof(ResidualPushConstants));
+    init_compute_pipeline(_jacobi_converged_pipeline_handle, _jacobi_converged_pipeline_layout_handle, spv_direcory_path() + "jacobi_converged.comp.spv", residual_layouts, sizeof(ResidualPushConstants));
+
+    _residual_checks  = { _config.pressure_tolerance > 0.0f && _config.pressure_solver == PressureSolver::JACOBI };
+    _residual_history = { _config.log_residuals };
+
+    #if DEBUG_LEVEL >= 1
+    if (_residual_checks)
+        LOG(pressure_solver_name() + " pressure solves stop below a residual of " + std::to_string(_config.pressure_tolerance) + ", checked every " + std::to_string(_config.residual_check_interval) + " dispatches.", COMPONENT_NAME);
+
+    if (_residual_history)
+        LOG(pressure_solver_name() + " pressure residuals are logged every " + std::to_string(RESIDUAL_LOG_INTERVAL) + " frames (last substep of the frame).", COMPONENT_NAME);
+    #endif
+}
+
+void Engine::reset_residual_state(VkCommandBuffer cmd_buff, VkExtent2D workgroup_size, uint32_t history_offset)
+{
+    ResidualState state {};
+    state.full_dispatch = { (_draw_extent.width + workgroup_size.width - 1) / workgroup_size.width, (_draw_extent.height + workgroup_size.height - 1) / workgroup_size.height, 1 };
+    state.dispatch      = { state.full_dispatch };
+
+    // Il solve precedente (anche di un altro frame) deve aver finito di leggere lo stato
+    VkMemoryBarrier memory_barrier {};
+    memory_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory_barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    memory_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdUpdateBuffer(cmd_buff, _residual_buffer._buffer_handle, 0, sizeof(ResidualState), &state);
+
+    // Le voci dello storico partono da 0 e raccolgono il massimo con atomicMax
+    if (history_offset != NO_RESIDUAL_HISTORY)
+        vkCmdFillBuffer(cmd_buff, _residual_history_buffer._buffer_handle, history_offset * sizeof(uint32_t), MAX_RESIDUAL_HISTORY * sizeof(uint32_t), 0);
+
+    memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+}
+
+void Engine::record_residual(VkCommandBuffer cmd_buff, VkDescriptorSet field_descriptor_set_handle, uint32_t history_index)
+{
+    std::array<VkDescriptorSet, 2> descriptor_sets { field_descriptor_set_handle, _residual_descriptor_set_handle };
+
+    // Riduzione del residuo della pressione corrente, nello stato del controllo o in una voce dello storico
+    ResidualPushConstants pc {};
+    pc.tolerance     = { _config.pressure_tolerance };
+    pc.history_index = { history_index };
+
+    vkCmdBindPipeline(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, _jacobi_residual_pipeline_handle);
+    vkCmdBindDescriptorSets(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, _jacobi_residual_pipeline_layout_handle, 0, (uint32_t)descriptor_sets.size(), descriptor_sets.data(), 0, nullptr);
+    vkCmdPushConstants(cmd_buff, _jacobi_residual_pipeline_layout_handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ResidualPushConstants), &pc);
+    dispatch_grid(cmd_buff, _draw_extent, pipeline_workgroup_size(_jacobi_residual_pipeline_handle));
+
+    compute_barrier(cmd_buff);
+}
+
+void Engine::record_residual_check(VkCommandBuffer cmd_buff, VkDescriptorSet field_descriptor_set_handle)
+{
+    record_residual(cmd_buff, field_descriptor_set_handle, NO_RESIDUAL_HISTORY);
+
+    // Confronto con la tolleranza e aggiornamento del dispatch indiretto
+    ResidualPushConstants pc {};
+    pc.tolerance     = { _config.pressure_tolerance };
+    pc.history_index = { NO_RESIDUAL_HISTORY };
+
+    vkCmdBindPipeline(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, _jacobi_converged_pipeline_handle);
+    vkCmdBindDescriptorSets(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, _jacobi_converged_pipeline_layout_handle, 1, 1, &_residual_descriptor_set_handle, 0, nullptr);
+    vkCmdPushConstants(cmd_buff, _jacobi_converged_pipeline_layout_handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ResidualPushConstants), &pc);
+    vkCmdDispatch(cmd_buff, 1, 1, 1);
+
+    VkMemoryBarrier memory_barrier {};
+    memory_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+}
+
+uint32_t Engine::residual_history_offset(uint32_t solve_index) const
+{
+    return ((uint32_t)(_frame_counter % FRAME_OVERLAP) * PRESSURE_SOLVES_PER_STEP + solve_index) * MAX_RESIDUAL_HISTORY;
+}
+
+void Engine::consume_residual_history(Frame& frame)
+{
+    if (frame._residual_history_steps == 0)
+        return;
+
+    uint32_t steps { frame._residual_history_steps };
+    frame._residual_history_steps = { 0 };
+
+    if (_frame_counter < _last_residual_log_frame + RESIDUAL_LOG_INTERVAL)
+        return;
+
+    _last_residual_log_frame = { _frame_counter };
+
+    // Il fence (o il timeline semaphore) di questo frame slot copre gli step che hanno scritto la sua parte
+    vmaInvalidateAllocation(_allocator, _residual_history_buffer._allocation, 0, VK_WHOLE_SIZE);
+
+    const uint32_t* history { (const uint32_t*)_residual_history_buffer._allocation_info.pMappedData };
+
+    // Una voce per dispatch di Jacobi, o per iterazione di SOR e PCG; il solve spettrale
+    // è esatto e ha solo il residuo prima e dopo
+    int iterations { _config.pressure_solver == PressureSolver::FFT ? 1 : (int)_config.pressure_iterations };
+    int block      { _config.pressure_solver == PressureSolver::JACOBI ? (int)_config.jacobi_block_iterations : 1 };
+    int dispatches { (iterations + block - 1) / block };
+
+    uint32_t entries { std::min((uint32_t)dispatches + 1, MAX_RESIDUAL_HISTORY) };
+
+    std::string label { " (" + pressure_solver_name() + (steps > 1 ? ", last of " + std::to_string(steps) + " substeps)" : ")") };
+
+    for (uint32_t solve = 0; solve < PRESSURE_SOLVES_PER_STEP; ++solve)
+    {
+        const uint32_t* values { history + residual_history_offset(solve) };
+
+        // Con campi nulli (es. il primo step) il residuo iniziale è già 0: non c'è niente da risolvere
+        if (values[0] == 0)
+        {
+            LOG("pressure_" + std::to_string(solve + 1) + label + " trivial solve, zero initial residual", COMPONENT_NAME);
+            continue;
+        }
+
+        // Dopo l'uscita anticipata le voci restano a 0
+        uint32_t recorded { 1 };
+
+        while (recorded < entries && values[recorded] != 0)
+            ++recorded;
+
+        float first {};
+        float last  {};
+        std::memcpy(&first, &values[0], sizeof(float));
+        std::memcpy(&last, &values[recorded - 1], sizeof(float));
+
+        std::ostringstream message {};
+        message << std::scientific;
+        message.precision(2);
+        message << "pressure_" << solve + 1 << label << (block > 1 ? " residual per dispatch:" : " residual per iteration:");
+
+        for (uint32_t k = 0; k < recorded; ++k)
+        {
+            float residual {};
+            std::memcpy(&residual, &values[k], sizeof(float));
+            message << ' ' << residual;
+        }
+
+        // Iterazioni eseguite dai primi recorded - 1 dispatch (ripartite come in run_jacobi_solver)
+        int done {};
+
+        for (int i = 0; i + 1 < (int)recorded; ++i)
+            done += iterations / dispatches + (i < iterations % dispatches ? 1 : 0);
+
+        if (done > 0 && first > 0.0f && last > 0.0f)
+        {
+            message << std::fixed;
+            message.precision(3);
+            message << " (x" << std::pow(last / first, 1.0f / done) << " per iteration)";
+        }
+
+        if (recorded < entries)
+            message << ", converged after " << recorded - 1 << (block > 1 ? " dispatches" : " iterations");
+
+        LOG(message.str(), COMPONENT_NAME);
+    }
+}
+
+std::string Engine::pressure_solver_name() const
+{
+    switch (_config.pressure_solver)
+    {
+        case PressureSolver::MULTIGRID: return "Multigrid";
+        case PressureSolver::SOR:       return "SOR";
+        case PressureSolver::PCG:       return "PCG";
+        case PressureSolver::FFT:       return "FFT";
+        case PressureSolver::JACOBI:
+        default:                        return "Jacobi";
+    }
+}
+
+void Engine::compute_barrier(VkCommandBuffer cmd_buff)
+{
+    // Le scritture del pass precedente devono essere visibili (e concluse) prima del successivo
+    VkMemoryBarrier memory_barrier {};
+    memory_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+}
+
+VkDescriptorSet Engine::field_descriptor_set() const
+{
+    return _descriptor_set_handles[_velocity_index][_pressure_index];
+}
+
+void Engine::dispatch_compute(VkCommandBuffer cmd_buff, VkPipeline pipeline_handle, VkPipelineLayout pipeline_layout_handle, const ComputePushConstants& pc)
+{
+    VkDescriptorSet descriptor_set_handle { field_descriptor_set() };
+
+    vkCmdBindPipeline(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_handle);
+    vkCmdBindDescriptorSets(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_handle, 0, 1, &descriptor_set_handle, 0, nullptr);
+    vkCmdPushConstants(cmd_buff, pipeline_layout_handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &pc);
+    dispatch_grid(cmd_buff, _draw_extent, pipeline_workgroup_size(pipeline_handle));
+}
+
+void Engine::dispatch_grid(VkCommandBuffer cmd_buff, VkExtent2D extent, VkExtent2D workgroup_size)
+{
+    vkCmdDispatch(cmd_buff, (extent.width + workgroup_size.width - 1) / workgroup_size.width, (extent.height + workgroup_size.height - 1) / workgroup_size.height, 1);
+}
+
+glm::ivec2 Engine::grid_mouse_position() const
+{
+    // Il mouse è in pixel della finestra, gli shader lavorano in celle della griglia
+    if (_window_extent.width == 0 || _window_extent.height == 0)
+        return glm::ivec2(_input_handler.mouse_x, _input_handler.mouse_y);
+
+    return glm::ivec2
+    (
+        (int64_t)_input_handler.mouse_x * _config.grid_width  / _window_extent.width,
+        (int64_t)_input_handler.mouse_y * _config.grid_height / _window_extent.height
+    );
+}
+
+void Engine::compute_simulation_step(VkCommandBuffer cmd_buff)
+{
+    ComputePushConstants pc {};
+    pc.mouse_down   = _input_handler.mouse_down;
+    pc.delta_time   = _config.fixed_delta_time;
+    pc.mouse_pos    = grid_mouse_position();
+
+    // --inject tiene premuto un punto fisso della griglia, anche senza input (headless)
+    if (_config.inject)
+    {
+        pc.mouse_down = { 1 };
+        pc.mouse_pos  = glm::ivec2(_config.inject_x, _config.inject_y);
+    }
+
+    // Assicura che tutte le operazioni di scrittura siano completate prima del prossimo step
+    VkMemoryBarrier memory_barrier {};
+    memory_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    //LOG("Delta time: " + _stopwatch.elapsed_as_string(), COMPONENT_NAME);
+
+    // diffusion
+    // pressure
     // remove divergency
     // advection
     // pressure
     // rempove divergency
 
-    // Diffusion pass
-    run_jacobi_solver(cmd_buff, _jacobi_diffusion_pipeline_handle, _jacobi_diffusion_pipeline_layout_handle, pc, NUM_ITER );
+    // Diffusion pass
+    _gpu_profiler.begin_pass(cmd_buff, "diffusion");
+    run_jacobi_diffusion(cmd_buff, pc, DIFFUSION_ITERATIONS);
+    _gpu_profiler.end_pass(cmd_buff);
+
+    // Assicura che tutte le operazioni di scrittura siano completate prima del prossimo step
+    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+
+    // Pressure pass
+    _gpu_profiler.begin_pass(cmd_buff, "pressure_1");
+    solve_pressure(cmd_buff, pc, 0);
+    _gpu_profiler.end_pass(cmd_buff);
+
+    // Assicura che tutte le operazioni di scrittura siano completate prima del prossimo step
+    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+
+    // Remove divergence pass
+    _gpu_profiler.begin_pass(cmd_buff, "remove_divergency_1");
+    dispatch_compute(cmd_buff, _remove_divergency_pipeline_handle, _remove_divergency_pipeline_layout_handle, pc);
+    _gpu_profiler.end_pass(cmd_buff);
+
+    // Assicura che tutte le operazioni di scrittura siano completate prima del prossimo step
+    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+
+    // Advection pass
+    _gpu_profiler.begin_pass(cmd_buff, "advection");
+    run_advection(cmd_buff, pc);
+    _gpu_profiler.end_pass(cmd_buff);
+
+    // La velocità advetta è in velocity_next: diventa la corrente senza copie
+    _velocity_index = 1 - _velocity_index;
+
+    // Assicura che tutte le operazioni di scrittura siano completate prima del prossimo step
+    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+
+    // Pressure pass
+    _gpu_profiler.begin_pass(cmd_buff, "pressure_2");
+    solve_pressure(cmd_buff, pc, 1);
+    _gpu_profiler.end_pass(cmd_buff);
+
+    // Assicura che tutte le operazioni di scrittura siano completate prima del prossimo step
+    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+
+    // Remove divergence pass
+    _gpu_profiler.begin_pass(cmd_buff, "remove_divergency_2");
+    dispatch_compute(cmd_buff, _remove_divergency_pipeline_handle, _remove_divergency_pipeline_layout_handle, pc);
+    _gpu_profiler.end_pass(cmd_buff);
+
+    // Assicura che tutte le operazioni di scrittura siano completate prima del prossimo step
+    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+
+    // Lo storico del residuo viene letto dalla CPU dopo il fence di questo frame
+    if (_residual_history)
+    {
+        VkMemoryBarrier host_barrier {};
+        host_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        host_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+        vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &host_barrier, 0, nullptr, 0, nullptr);
+
+        ++current_frame()._residual_history_steps;
+    }
+}
+
+void Engine::solve_pressure(VkCommandBuffer cmd_buff, const ComputePushConstants& pc, uint32_t solve_index)
+{
+    // Senza warm start ogni solve riparte da zero: serve solo a misurare quanto fa
+    // risparmiare la pressione del solve precedente come soluzione iniziale
+    if (!_config.pressure_warm_start)
+        clear_field_image(cmd_buff, _pressure_images[_pressure_index]);
+
+    switch (_config.pressure_solver)
+    {
+        case PressureSolver::MULTIGRID:
+        {
+            run_multigrid_solver(cmd_buff, pc);
+            break;
+        }
+
+        case PressureSolver::SOR:
+        {
+            run_sor_pressure(cmd_buff, (int)_config.pressure_iterations, solve_index);
+            break;
+        }
+
+        case PressureSolver::PCG:
+        {
+            run_pcg_solver(cmd_buff, (int)_config.pressure_iterations, solve_index);
+            break;
+        }
+
+        case PressureSolver::FFT:
+        {
+            run_fft_solver(cmd_buff, solve_index);
+            break;
+        }
 
-    // Assicura che tutte le operazioni di scrittura siano completate prima del prossimo step
-    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+        case PressureSolver::JACOBI:
+        default:
+        {
+            run_jacobi_pressure(cmd_buff, pc, (int)_config.pressure_iterations, solve_index);
+            break;
+        }
+    }
+}
 
-    // Pressure pass
-    run_jacobi_solver(cmd_buff, _jacobi_pressure_pipeline_handle, _jacobi_pressure_pipeline_layout_handle, pc, NUM_ITER );
+void Engine::run_sor_pressure(VkCommandBuffer cmd_buff, int iterations, std::optional<uint32_t> solve_index)
+{
+    // Nessun ping-pong: _pressure_index non cambia e pressure_next resta ferma
+    VkDescriptorSet field_descriptor_set_handle { field_descriptor_set() };
 
-    // Assicura che tutte le operazioni di scrittura siano completate prima del prossimo step
-    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+    // Ogni thread aggiorna una cella su due della propria riga
+    VkExtent2D half_extent    { (_draw_extent.width + 1) / 2, _draw_extent.height };
+    VkExtent2D workgroup_size { pipeline_workgroup_size(_sor_pressure_pipeline_handle) };
 
-    // Remove divergence pass
-    dispatch_compute(cmd_buff, _remove_divergency_pipeline_handle, _remove_divergency_pipeline_layout_handle, pc);
+    std::optional<uint32_t> history_offset {};
 
-    // Assicura che tutte le operazioni di scrittura siano completate prima del prossimo step
-    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+    if (_residual_history && solve_index)
+    {
+        history_offset = { residual_history_offset(*solve_index) };
 
-    // Advection pass
-    dispatch_compute(cmd_buff, _advection_pipeline_handle, _advection_pipeline_layout_handle, pc);
+        reset_residual_state(cmd_buff, pipeline_workgroup_size(_jacobi_residual_pipeline_handle), *history_offset);
+        record_residual(cmd_buff, field_descriptor_set_handle, *history_offset);
+    }
 
-    // Assicura che tutte le operazioni di scrittura siano completate prima del prossimo step
-    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+    for (int i = 0; i < iterations; ++i)
+    {
+        vkCmdBindPipeline(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, _sor_pressure_pipeline_handle);
+        vkCmdBindDescriptorSets(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, _sor_pressure_pipeline_layout_handle, 0, 1, &field_descriptor_set_handle, 0, nullptr);
 
-    // Swap pass
-    dispatch_compute(cmd_buff, _swap_pipeline_handle, _swap_pipeline_layout_handle, pc);
+        // Le celle nere leggono le rosse appena aggiornate
+        for (uint32_t parity = 0; parity < 2; ++parity)
+        {
+            SorPushConstants pc { .parity = parity };
 
-    // Assicura che tutte le operazioni di scrittura siano completate prima del prossimo step
-    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+            vkCmdPushConstants(cmd_buff, _sor_pressure_pipeline_layout_handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SorPushConstants), &pc);
+            dispatch_grid(cmd_buff, half_extent, workgroup_size);
+            compute_barrier(cmd_buff);
+        }
 
-    // Pressure pass
-    run_jacobi_solver(cmd_buff, _jacobi_pressure_pipeline_handle, _jacobi_pressure_pipeline_layout_handle, pc, NUM_ITER );
+        if (history_offset && i + 1 < (int)MAX_RESIDUAL_HISTORY)
+            record_residual(cmd_buff, field_descriptor_set_handle, *history_offset + i + 1);
+    }
+}
 
-    // Assicura che tutte le operazioni di scrittura siano completate prima del prossimo step
-    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+void Engine::clear_field_image(VkCommandBuffer cmd_buff, const AllocatedImage& image)
+{
+    VkClearColorValue       clear_value {};
+    VkImageSubresourceRange clear_range { vkinit::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT) };
 
-    // Remove divergence pass
-    dispatch_compute(cmd_buff, _remove_divergency_pipeline_handle, _remove_divergency_pipeline_layout_handle, pc);
+    // I pass precedenti devono aver finito con l'immagine, e i successivi vedere gli zeri
+    transition_image_layout(cmd_buff, image._image_handle, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+    vkCmdClearColorImage(cmd_buff, image._image_handle, VK_IMAGE_LAYOUT_GENERAL, &clear_value, 1, &clear_range);
+    transition_image_layout(cmd_buff, image._image_handle, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+}
 
-    // Assicura che tutte le operazioni di scrittura siano completate prima del prossimo step
-    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+void Engine::init_pcg()
+{
+    VkExtent3D grid_extent { _pressure_images[0]._image_extent };
 
-    _stopwatch.start();
+    for (AllocatedImage& image : _pcg_images)
+        image = { create_image(VK_FORMAT_R32_SFLOAT, grid_extent, VK_IMAGE_USAGE_STORAGE_BIT) };
+
+    // Una somma parziale (vec2) per workgroup della griglia
+    _pcg_partial_count = { ((grid_extent.width + PCG_WORKGROUP_SIZE.width - 1) / PCG_WORKGROUP_SIZE.width) * ((grid_extent.height + PCG_WORKGROUP_SIZE.height - 1) / PCG_WORKGROUP_SIZE.height) };
+
+    VkBufferUsageFlags state_usages { VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT };
+
+    _pcg_state_buffer    = { create_buffer(sizeof(PcgState), state_usages, 0) };
+    _pcg_partials_buffer = { create_buffer(_pcg_partial_count * 2 * sizeof(float), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 0) };
+
+    std::vector<DescriptorAllocator::PoolSizeRatio> sizes =
+    {
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,  4.0f }
+    };
+
+    _pcg_descriptor_allocator.init_pool(_device_handle, 1, sizes);
+
+    DescriptorLayoutBuilder layout_builder {};
+    layout_builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    layout_builder.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+
+    for (uint32_t i = 0; i < 4; ++i)
+        layout_builder.add_binding(2 + i, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+
+    _pcg_descriptor_set_layout_handle = layout_builder.build(_device_handle, VK_SHADER_STAGE_COMPUTE_BIT);
+    _pcg_descriptor_set_handle        = _pcg_descriptor_allocator.allocate(_device_handle, _pcg_descriptor_set_layout_handle);
+
+    DescriptorWriter writer {};
+    writer.write_buffer(0, _pcg_state_buffer._buffer_handle, sizeof(PcgState), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    writer.write_buffer(1, _pcg_partials_buffer._buffer_handle, _pcg_partial_count * 2 * sizeof(float), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+
+    for (uint32_t i = 0; i < 4; ++i)
+        writer.write_image(2 + i, _pcg_images[i]._image_view_handle, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+
+    writer.update_set(_device_handle, _pcg_descriptor_set_handle);
+
+    _deletion_queue.enqueue_deletor(
+        [&](){
+            _pcg_descriptor_allocator.destroy_pool(_device_handle);
+            vkDestroyDescriptorSetLayout(_device_handle, _pcg_descriptor_set_layout_handle, nullptr);
+            destroy_buffer(_pcg_state_buffer);
+            destroy_buffer(_pcg_partials_buffer);
+        }
+    );
+
+    // Layout: campi (set 0) + vettori e stato del solver (set 1)
+    std::array<VkDescriptorSetLayout, 2> pcg_layouts { _descriptor_set_layout_handle, _pcg_descriptor_set_layout_handle };
+
+    init_compute_pipeline(_pcg_init_pipeline_handle, _pcg_init_pipeline_layout_handle, field_shader_path("pcg_init"), pcg_layouts, sizeof(PcgPushConstants), PCG_WORKGROUP_SIZE);
+    init_compute_pipeline(_pcg_update_pipeline_handle, _pcg_update_pipeline_layout_handle, field_shader_path("pcg_update"), pcg_layouts, sizeof(PcgPushConstants), PCG_WORKGROUP_SIZE);
+    init_compute_pipeline(_pcg_precondition_pipeline_handle, _pcg_precondition_pipeline_layout_handle, spv_direcory_path() + "pcg_precondition.comp.spv", pcg_layouts, sizeof(PcgPushConstants), PCG_WORKGROUP_SIZE);
+    init_compute_pipeline(_pcg_spmv_pipeline_handle, _pcg_spmv_pipeline_layout_handle, spv_direcory_path() + "pcg_spmv.comp.spv", pcg_layouts, sizeof(PcgPushConstants), PCG_WORKGROUP_SIZE);
+    init_compute_pipeline(_pcg_direction_pipeline_handle, _pcg_direction_pipeline_layout_handle, spv_direcory_path() + "pcg_direction.comp.spv", pcg_layouts, sizeof(PcgPushConstants), PCG_WORKGROUP_SIZE);
+    init_compute_pipeline(_pcg_reduce_pipeline_handle, _pcg_reduce_pipeline_layout_handle, spv_direcory_path() + "pcg_reduce.comp.spv", pcg_layouts, sizeof(PcgPushConstants), PCG_REDUCE_WORKGROUP_SIZE);
+
+    #if DEBUG_LEVEL >= 1
+    std::string preconditioner { _config.pcg_preconditioner == PcgPreconditioner::JACOBI ? "Jacobi" : "incomplete Poisson" };
+    LOG("PCG pressure solver with " + preconditioner + " preconditioner, up to " + std::to_string(_config.pressure_iterations) + " iterations per solve.", COMPONENT_NAME);
+    #endif
+}
+
+void Engine::reset_pcg_state(VkCommandBuffer cmd_buff)
+{
+    PcgState state {};
+    state.dispatch        = { (_draw_extent.width + PCG_WORKGROUP_SIZE.width - 1) / PCG_WORKGROUP_SIZE.width, (_draw_extent.height + PCG_WORKGROUP_SIZE.height - 1) / PCG_WORKGROUP_SIZE.height, 1 };
+    state.reduce_dispatch = { 1, 1, 1 };
+
+    // Il solve precedente deve aver finito di usare lo stato, anche come dispatch indiretto
+    VkMemoryBarrier memory_barrier {};
+    memory_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory_barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    memory_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdUpdateBuffer(cmd_buff, _pcg_state_buffer._buffer_handle, 0, sizeof(PcgState), &state);
+
+    memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+}
+
+void Engine::dispatch_pcg(VkCommandBuffer cmd_buff, VkPipeline pipeline_handle, VkPipelineLayout pipeline_layout_handle, VkDeviceSize indirect_offset, uint32_t phase)
+{
+    std::array<VkDescriptorSet, 2> descriptor_sets { field_descriptor_set(), _pcg_descriptor_set_handle };
+
+    PcgPushConstants pc {};
+    pc.phase         = { phase };
+    pc.partial_count = { _pcg_partial_count };
+    pc.tolerance     = { _config.pressure_tolerance };
+
+    vkCmdBindPipeline(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_handle);
+    vkCmdBindDescriptorSets(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_handle, 0, (uint32_t)descriptor_sets.size(), descriptor_sets.data(), 0, nullptr);
+    vkCmdPushConstants(cmd_buff, pipeline_layout_handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PcgPushConstants), &pc);
+    vkCmdDispatchIndirect(cmd_buff, _pcg_state_buffer._buffer_handle, indirect_offset);
+
+    // Il pass successivo legge i vettori e gli scalari appena scritti, e pcg_reduce.comp
+    // può aver azzerato i dispatch indiretti che seguono
+    VkMemoryBarrier memory_barrier {};
+    memory_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+    vkCmdPipelineBarrier(cmd_buff, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+}
+
+void Engine::run_pcg_solver(VkCommandBuffer cmd_buff, int iterations, std::optional<uint32_t> solve_index)
+{
+    // La soluzione si aggiorna sul posto nella pressione corrente: _pressure_index non cambia
+    const VkDeviceSize grid    { offsetof(PcgState, dispatch) };
+    const VkDeviceSize reduced { offsetof(PcgState, reduce_dispatch) };
+
+    std::optional<uint32_t> history_offset {};
+
+    if (_residual_history && solve_index)
+    {
+        history_offset = { residual_history_offset(*solve_index) };
+
+        reset_residual_state(cmd_buff, pipeline_workgroup_size(_jacobi_residual_pipeline_handle), *history_offset);
+        record_residual(cmd_buff, field_descriptor_set(), *history_offset);
+    }
+
+    // r = b - A x, z = M^-1 r, p = z
+    reset_pcg_state(cmd_buff);
+    dispatch_pcg(cmd_buff, _pcg_init_pipeline_handle, _pcg_init_pipeline_layout_handle, grid);
+    dispatch_pcg(cmd_buff, _pcg_precondition_pipeline_handle, _pcg_precondition_pipeline_layout_handle, grid);
+    dispatch_pcg(cmd_buff, _pcg_reduce_pipeline_handle, _pcg_reduce_pipeline_layout_handle, reduced, PCG_PHASE_START);
+    dispatch_pcg(cmd_buff, _pcg_direction_pipeline_handle, _pcg_direction_pipeline_layout_handle, grid);
+
+    // Tutte le iterazioni vengono registrate: dopo la convergenza i dispatch sono vuoti
+    for (int i = 0; i < iterations; ++i)
+    {
+        // q = A p, alpha = r·z / p·q
+        dispatch_pcg(cmd_buff, _pcg_spmv_pipeline_handle, _pcg_spmv_pipeline_layout_handle, grid);
+        dispatch_pcg(cmd_buff, _pcg_reduce_pipeline_handle, _pcg_reduce_pipeline_layout_handle, reduced, PCG_PHASE_ALPHA);
+
+        // x += alpha p, r -= alpha q
+        dispatch_pcg(cmd_buff, _pcg_update_pipeline_handle, _pcg_update_pipeline_layout_handle, grid);
+
+        // z = M^-1 r, beta = r·z nuovo / r·z precedente, controllo della tolleranza
+        dispatch_pcg(cmd_buff, _pcg_precondition_pipeline_handle, _pcg_precondition_pipeline_layout_handle, grid);
+        dispatch_pcg(cmd_buff, _pcg_reduce_pipeline_handle, _pcg_reduce_pipeline_layout_handle, reduced, PCG_PHASE_BETA);
+
+        // p = z + beta p, inutile dopo l'ultima iterazione
+        if (i + 1 < iterations)
+            dispatch_pcg(cmd_buff, _pcg_direction_pipeline_handle, _pcg_direction_pipeline_layout_handle, grid);
+
+        if (history_offset && i + 1 < (int)MAX_RESIDUAL_HISTORY)
+            record_residual(cmd_buff, field_descriptor_set(), *history_offset + i + 1);
+    }
+}
+
+bool Engine::linear_filter_supported(VkFormat format) const
+{
+    VkFormatProperties format_properties {};
+    vkGetPhysicalDeviceFormatProperties(_physical_device_handle, format, &format_properties);
+
+    return (format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0;
+}
+
+void Engine::init_sampled_advection()
+{
+    // Bordo a zero invece del clamp-to-edge: fuori dalla griglia la velocità vale 0,
+    // come per le imageLoad fuori dall'immagine negli altri kernel
+    VkSamplerCreateInfo sampler_create_info {};
+    sampler_create_info.sType         = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_create_info.magFilter     = VK_FILTER_LINEAR;
+    sampler_create_info.minFilter     = VK_FILTER_LINEAR;
+    sampler_create_info.mipmapMode    = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_create_info.addressModeU  = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    sampler_create_info.addressModeV  = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    sampler_create_info.addressModeW  = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    sampler_create_info.borderColor   = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+    sampler_create_info.minLod        = 0.0f;
+    sampler_create_info.maxLod        = 0.0f;
+
+    result_check(vkCreateSampler(_device_handle, &sampler_create_info, nullptr, &_velocity_sampler_handle));
+
+    std::vector<DescriptorAllocator::PoolSizeRatio> sizes =
+    {
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f }
+    };
+
+    _advection_sampler_descriptor_allocator.init_pool(_device_handle, 2, sizes);
+
+    DescriptorLayoutBuilder layout_builder {};
+    layout_builder.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+
+    _advection_sampler_descriptor_set_layout_handle = layout_builder.build(_device_handle, VK_SHADER_STAGE_COMPUTE_BIT);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        _advection_sampler_descriptor_set_handles[i] = _advection_sampler_descriptor_allocator.allocate(_device_handle, _advection_sampler_descriptor_set_layout_handle);
+
+        // Le immagini dei campi restano in GENERAL, valido anche per il campionamento
+        DescriptorWriter writer {};
+        writer.write_image(0, _velocity_images[i]._image_view_handle, _velocity_sampler_handle, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+        writer.update_set(_device_handle, _advection_sampler_descriptor_set_handles[i]);
+    }
+
+    _deletion_queue.enqueue_deletor(
+        [&](){
+            _advection_sampler_descriptor_allocator.destroy_pool(_device_handle);
+            vkDestroyDescriptorSetLayout(_device_handle, _advection_sampler_descriptor_set_layout_handle, nullptr);
+            vkDestroySampler(_device_handle, _velocity_sampler_handle, nullptr);
+        }
+    );
+
+    // Layout: campi (set 0) + velocità campionata (set 1)
+    std::array<VkDescriptorSetLayout, 2> sampled_layouts { _descriptor_set_layout_handle, _advection_sampler_descriptor_set_layout_handle };
+
+    init_compute_pipeline(_advection_sampled_pipeline_handle, _advection_sampled_pipeline_layout_handle, field_shader_path("advection_sampled"), sampled_layouts, sizeof(ComputePushConstants), kernel_workgroup_size("advection"));
+
+    #if DEBUG_LEVEL >= 1
+    LOG("Semi-Lagrangian advection through a linear filtering sampler.", COMPONENT_NAME);
+    #endif
+}
+
+void Engine::init_maccormack()
+{
+    _maccormack_predicted_image = { create_image(_velocity_format, _velocity_images[0]._image_extent, VK_IMAGE_USAGE_STORAGE_BIT) };
+
+    std::vector<DescriptorAllocator::PoolSizeRatio> sizes =
+    {
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f }
+    };
+
+    _maccormack_descriptor_allocator.init_pool(_device_handle, 1, sizes);
+
+    DescriptorLayoutBuilder layout_builder {};
+    layout_builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+
+    _maccormack_descriptor_set_layout_handle = layout_builder.build(_device_handle, VK_SHADER_STAGE_COMPUTE_BIT);
+    _maccormack_descriptor_set_handle        = _maccormack_descriptor_allocator.allocate(_device_handle, _maccormack_descriptor_set_layout_handle);
+
+    DescriptorWriter writer {};
+    writer.write_image(0, _maccormack_predicted_image._image_view_handle, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    writer.update_set(_device_handle, _maccormack_descriptor_set_handle);
+
+    _deletion_queue.enqueue_deletor(
+        [&](){
+            _maccormack_descriptor_allocator.destroy_pool(_device_handle);
+            vkDestroyDescriptorSetLayout(_device_handle, _maccormack_descriptor_set_layout_handle, nullptr);
+        }
+    );
+
+    // Layout: campi (set 0) + predizione (set 1); stesso workgroup dell'advezione semi-lagrangiana
+    std::array<VkDescriptorSetLayout, 2> maccormack_layouts { _descriptor_set_layout_handle, _maccormack_descriptor_set_layout_handle };
+
+    init_compute_pipeline(_maccormack_predict_pipeline_handle, _maccormack_predict_pipeline_layout_handle, field_shader_path("maccormack_predict"), maccormack_layouts, sizeof(ComputePushConstants), kernel_workgroup_size("advection"));
+    init_compute_pipeline(_maccormack_correct_pipeline_handle, _maccormack_correct_pipeline_layout_handle, field_shader_path("maccormack_correct"), maccormack_layouts, sizeof(ComputePushConstants), kernel_workgroup_size("advection"));
+
+    #if DEBUG_LEVEL >= 1
+    LOG("MacCormack advection enabled.", COMPONENT_NAME);
+    #endif
+}
+
+void Engine::run_advection(VkCommandBuffer cmd_buff, const ComputePushConstants& pc)
+{
+    if (_config.advection == AdvectionScheme::SEMI_LAGRANGIAN && _sampled_advection)
+    {
+        std::array<VkDescriptorSet, 2> descriptor_sets { field_descriptor_set(), _advection_sampler_descriptor_set_handles[_velocity_index] };
+
+        vkCmdBindPipeline(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, _advection_sampled_pipeline_handle);
+        vkCmdBindDescriptorSets(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, _advection_sampled_pipeline_layout_handle, 0, (uint32_t)descriptor_sets.size(), descriptor_sets.data(), 0, nullptr);
+        vkCmdPushConstants(cmd_buff, _advection_sampled_pipeline_layout_handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &pc);
+        dispatch_grid(cmd_buff, _draw_extent, pipeline_workgroup_size(_advection_sampled_pipeline_handle));
+        return;
+    }
+
+    if (_config.advection == AdvectionScheme::SEMI_LAGRANGIAN)
+    {
+        dispatch_compute(cmd_buff, _advection_pipeline_handle, _advection_pipeline_layout_handle, pc);
+        return;
+    }
+
+    std::array<VkDescriptorSet, 2> descriptor_sets { field_descriptor_set(), _maccormack_descriptor_set_handle };
+
+    // Predizione in avanti
+    vkCmdBindPipeline(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, _maccormack_predict_pipeline_handle);
+    vkCmdBindDescriptorSets(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, _maccormack_predict_pipeline_layout_handle, 0, (uint32_t)descriptor_sets.size(), descriptor_sets.data(), 0, nullptr);
+    vkCmdPushConstants(cmd_buff, _maccormack_predict_pipeline_layout_handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &pc);
+    dispatch_grid(cmd_buff, _draw_extent, pipeline_workgroup_size(_maccormack_predict_pipeline_handle));
+
+    // La correzione legge la predizione delle celle vicine
+    compute_barrier(cmd_buff);
+
+    vkCmdBindPipeline(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, _maccormack_correct_pipeline_handle);
+    vkCmdBindDescriptorSets(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, _maccormack_correct_pipeline_layout_handle, 0, (uint32_t)descriptor_sets.size(), descriptor_sets.data(), 0, nullptr);
+    vkCmdPushConstants(cmd_buff, _maccormack_correct_pipeline_layout_handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &pc);
+    dispatch_grid(cmd_buff, _draw_extent, pipeline_workgroup_size(_maccormack_correct_pipeline_handle));
+}
+
+void Engine::init_fft()
+{
+    _fft_spectrum_image = { create_image(VK_FORMAT_R32_SFLOAT, _pressure_images[0]._image_extent, VK_IMAGE_USAGE_STORAGE_BIT) };
+
+    std::vector<DescriptorAllocator::PoolSizeRatio> sizes =
+    {
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f }
+    };
+
+    _fft_descriptor_allocator.init_pool(_device_handle, 1, sizes);
+
+    DescriptorLayoutBuilder layout_builder {};
+    layout_builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+
+    _fft_descriptor_set_layout_handle = layout_builder.build(_device_handle, VK_SHADER_STAGE_COMPUTE_BIT);
+    _fft_descriptor_set_handle        = _fft_descriptor_allocator.allocate(_device_handle, _fft_descriptor_set_layout_handle);
+
+    DescriptorWriter writer {};
+    writer.write_image(0, _fft_spectrum_image._image_view_handle, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    writer.update_set(_device_handle, _fft_descriptor_set_handle);
+
+    _deletion_queue.enqueue_deletor(
+        [&](){
+            _fft_descriptor_allocator.destroy_pool(_device_handle);
+            vkDestroyDescriptorSetLayout(_device_handle, _fft_descriptor_set_layout_handle, nullptr);
+        }
+    );
+
+    // Layout: campi (set 0) + spettro (set 1)
+    std::array<VkDescriptorSetLayout, 2> fft_layouts { _descriptor_set_layout_handle, _fft_descriptor_set_layout_handle };
+
+    init_compute_pipeline(_fft_rows_pipeline_handle, _fft_rows_pipeline_layout_handle, field_shader_path("fft_rows"), fft_layouts, sizeof(FftPushConstants), FFT_WORKGROUP_SIZE);
+    init_compute_pipeline(_fft_columns_pipeline_handle, _fft_columns_pipeline_layout_handle, spv_direcory_path() + "fft_columns.comp.spv", fft_layouts, sizeof(FftPushConstants), FFT_WORKGROUP_SIZE);
+
+    #if DEBUG_LEVEL >= 1
+    LOG("Spectral pressure solver with FFTs of " + std::to_string(2 * (_config.grid_width + 1)) + " and " + std::to_string(2 * (_config.grid_height + 1)) + " values.", COMPONENT_NAME);
+    #endif
+}
+
+void Engine::run_fft_solver(VkCommandBuffer cmd_buff, std::optional<uint32_t> solve_index)
+{
+    std::array<VkDescriptorSet, 2> descriptor_sets { field_descriptor_set(), _fft_descriptor_set_handle };
+
+    std::optional<uint32_t> history_offset {};
+
+    if (_residual_history && solve_index)
+    {
+        history_offset = { residual_history_offset(*solve_index) };
+
+        reset_residual_state(cmd_buff, pipeline_workgroup_size(_jacobi_residual_pipeline_handle), *history_offset);
+        record_residual(cmd_buff, descriptor_sets[0], *history_offset);
+    }
+
+    // Ogni workgroup trasforma due righe (o due colonne) insieme, come parte reale e immaginaria
+    uint32_t row_pairs    { (_draw_extent.height + 1) / 2 };
+    uint32_t column_pairs { (_draw_extent.width + 1) / 2 };
+
+    FftPushConstants pc {};
+
+    // Divergenza -> DST lungo x
+    pc.inverse = { 0 };
+    vkCmdBindPipeline(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, _fft_rows_pipeline_handle);
+    vkCmdBindDescriptorSets(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, _fft_rows_pipeline_layout_handle, 0, (uint32_t)descriptor_sets.size(), descriptor_sets.data(), 0, nullptr);
+    vkCmdPushConstants(cmd_buff, _fft_rows_pipeline_layout_handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FftPushConstants), &pc);
+    vkCmdDispatch(cmd_buff, row_pairs, 1, 1);
+    compute_barrier(cmd_buff);
+
+    // DST lungo y, divisione per gli autovalori, DST inversa lungo y
+    vkCmdBindPipeline(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, _fft_columns_pipeline_handle);
+    vkCmdBindDescriptorSets(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, _fft_columns_pipeline_layout_handle, 0, (uint32_t)descriptor_sets.size(), descriptor_sets.data(), 0, nullptr);
+    vkCmdPushConstants(cmd_buff, _fft_columns_pipeline_layout_handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FftPushConstants), &pc);
+    vkCmdDispatch(cmd_buff, column_pairs, 1, 1);
+    compute_barrier(cmd_buff);
+
+    // DST inversa lungo x -> pressione corrente (sovrascritta: il solve non parte dalla precedente)
+    pc.inverse = { 1 };
+    vkCmdBindPipeline(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, _fft_rows_pipeline_handle);
+    vkCmdBindDescriptorSets(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, _fft_rows_pipeline_layout_handle, 0, (uint32_t)descriptor_sets.size(), descriptor_sets.data(), 0, nullptr);
+    vkCmdPushConstants(cmd_buff, _fft_rows_pipeline_layout_handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FftPushConstants), &pc);
+    vkCmdDispatch(cmd_buff, row_pairs, 1, 1);
+    compute_barrier(cmd_buff);
+
+    if (history_offset)
+        record_residual(cmd_buff, descriptor_sets[0], *history_offset + 1);
 }
 
+void Engine::init_multigrid()
+{
+    // Piramide dei livelli grossolani: ogni livello dimezza la griglia precedente
+    VkExtent2D extent { _pressure_images[0]._image_extent.width, _pressure_images[0]._image_extent.height };
+    float      h2     { 1.0f };
+
+    VkImageUsageFlags image_usages { VK_IMAGE_USAGE_STORAGE_BIT };
+
+    while (std::min(extent.width, extent.height) > MULTIGRID_COARSEST_SIZE)
+    {
+        extent = { (extent.width + 1) / 2, (extent.height + 1) / 2 };
+        h2    *= 4.0f;
+
+        VkExtent3D image_extent { extent.width, extent.height, 1 };
+
+        MultigridLevel level {};
+        level._extent          = { extent };
+        level._h2              = { h2 };
+        level._error_images[0] = { create_image(VK_FORMAT_R32_SFLOAT, image_extent, image_usages) };
+        level._error_images[1] = { create_image(VK_FORMAT_R32_SFLOAT, image_extent, image_usages) };
+        level._rhs_image       = { create_image(VK_FORMAT_R32_SFLOAT, image_extent, image_usages) };
+
+        _multigrid_levels.push_back(level);
+    }
+
+    if (_multigrid_levels.empty())
+        return;
+
+    // Un descriptor set per livello e per verso del ping-pong dell'errore
+    std::vector<DescriptorAllocator::PoolSizeRatio> sizes =
+    {
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3.0f }
+    };
+
+    _multigrid_descriptor_allocator.init_pool(_device_handle, (uint32_t)_multigrid_levels.size() * 2, sizes);
+
+    DescriptorLayoutBuilder layout_builder {};
+    layout_builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    layout_builder.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    layout_builder.add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+
+    _multigrid_descriptor_set_layout_handle = layout_builder.build(_device_handle, VK_SHADER_STAGE_COMPUTE_BIT);
+
+    DescriptorWriter writer {};
+
+    for (MultigridLevel& level : _multigrid_levels)
+    {
+        for (int parity = 0; parity < 2; ++parity)
+        {
+            level._descriptor_set_handles[parity] = _multigrid_descriptor_allocator.allocate(_device_handle, _multigrid_descriptor_set_layout_handle);
+
+            writer.clear();
+            writer.write_image(0, level._error_images[parity]._image_view_handle, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+            writer.write_image(1, level._error_images[1 - parity]._image_view_handle, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+            writer.write_image(2, level._rhs_image._image_view_handle, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+            writer.update_set(_device_handle, level._descriptor_set_handles[parity]);
+        }
+    }
+
+    _deletion_queue.enqueue_deletor(
+        [&](){
+            _multigrid_descriptor_allocator.destroy_pool(_device_handle);
+            vkDestroyDescriptorSetLayout(_device_handle, _multigrid_descriptor_set_layout_handle, nullptr);
+        }
+    );
+
+    // Layout: livello fine a piena risoluzione (set 0) + livello grossolano (set 1)
+    std::array<VkDescriptorSetLayout, 2> field_level_layouts { _descriptor_set_layout_handle, _multigrid_descriptor_set_layout_handle };
+    std::array<VkDescriptorSetLayout, 2> level_level_layouts { _multigrid_descriptor_set_layout_handle, _multigrid_descriptor_set_layout_handle };
+
+    init_compute_pipeline(_multigrid_restrict_field_pipeline_handle, _multigrid_restrict_field_pipeline_layout_handle, field_shader_path("mg_restrict_field"), field_level_layouts, sizeof(MultigridPushConstants));
+    init_compute_pipeline(_multigrid_prolong_field_pipeline_handle, _multigrid_prolong_field_pipeline_layout_handle, field_shader_path("mg_prolong_field"), field_level_layouts, sizeof(MultigridPushConstants));
+    init_compute_pipeline(_multigrid_restrict_pipeline_handle, _multigrid_restrict_pipeline_layout_handle, spv_direcory_path() + "mg_restrict.comp.spv", level_level_layouts, sizeof(MultigridPushConstants));
+    init_compute_pipeline(_multigrid_prolong_pipeline_handle, _multigrid_prolong_pipeline_layout_handle, spv_direcory_path() + "mg_prolong.comp.spv", level_level_layouts, sizeof(MultigridPushConstants));
+    init_compute_pipeline(_multigrid_smooth_pipeline_handle, _multigrid_smooth_pipeline_layout_handle, spv_direcory_path() + "mg_smooth.comp.spv", { &_multigrid_descriptor_set_layout_handle, 1 }, sizeof(MultigridPushConstants));
+
+    #if DEBUG_LEVEL >= 1
+    LOG("Multigrid pyramid created with " + std::to_string(_multigrid_levels.size()) + " coarse levels.", COMPONENT_NAME);
+    #endif
+}
 
+void Engine::dispatch_multigrid( VkCommandBuffer cmd_buff,
+                                 VkPipeline pipeline_handle,
+                                 VkPipelineLayout pipeline_layout_handle,
+                                 std::span<const VkDescriptorSet> descriptor_sets,
+                                 const MultigridPushConstants& pc,
+                                 VkExtent2D extent )
+{
+    vkCmdBindPipeline(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_handle);
+    vkCmdBindDescriptorSets(cmd_buff, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_handle, 0, (uint32_t)descriptor_sets.size(), descriptor_sets.data(), 0, nullptr);
+    vkCmdPushConstants(cmd_buff, pipeline_layout_handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MultigridPushConstants), &pc);
+    dispatch_grid(cmd_buff, extent, pipeline_workgroup_size(pipeline_handle));
+}
 
+void Engine::smooth_multigrid_level(VkCommandBuffer cmd_buff, size_t level_index, uint32_t iterations)
+{
+    const MultigridLevel& level { _multigrid_levels[level_index] };
+    MultigridPushConstants pc { .h2 = level._h2, .omega = MULTIGRID_JACOBI_WEIGHT };
 
+    // Con un numero pari di iterazioni il risultato torna in _error_images[0]
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        dispatch_multigrid(cmd_buff, _multigrid_smooth_pipeline_handle, _multigrid_smooth_pipeline_layout_handle, { &level._descriptor_set_handles[i % 2], 1 }, pc, level._extent);
+        compute_barrier(cmd_buff);
+    }
+}
 
+void Engine::run_multigrid_solver(VkCommandBuffer cmd_buff, const ComputePushConstants& pc)
+{
+    const uint32_t smoothing { _config.multigrid_smoothing };
 
+    // Griglia troppo piccola per una piramide: resta il solo Jacobi
+    if (_multigrid_levels.empty())
+    {
+        run_jacobi_pressure(cmd_buff, pc, (int)_config.pressure_iterations);
+        return;
+    }
 
+    const MultigridPushConstants fine_pc { .h2 = 1.0f, .omega = MULTIGRID_JACOBI_WEIGHT };
 
+    for (uint32_t cycle = 0; cycle < _config.multigrid_cycles; ++cycle)
+    {
+        // Pre-smoothing a piena risoluzione
+        run_jacobi_pressure(cmd_buff, pc, smoothing);
 
+        // Residuo della pressione ristretto sul primo livello grossolano; il set del
+        // livello fine segue _pressure_index, che lo smoothing può aver invertito
+        std::array<VkDescriptorSet, 2> field_sets { field_descriptor_set(), _multigrid_levels[0]._descriptor_set_handles[0] };
+        dispatch_multigrid(cmd_buff, _multigrid_restrict_field_pipeline_handle, _multigrid_restrict_field_pipeline_layout_handle, field_sets, fine_pc, _multigrid_levels[0]._extent);
+        compute_barrier(cmd_buff);
 
+        // Ramo discendente della V: smoothing e restrizione del residuo
+        for (size_t l = 0; l + 1 < _multigrid_levels.size(); ++l)
+        {
+            smooth_multigrid_level(cmd_buff, l, smoothing);
 
+            MultigridPushConstants level_pc { .h2 = _multigrid_levels[l]._h2, .omega = MULTIGRID_JACOBI_WEIGHT };
+            std::array<VkDescriptorSet, 2> level_sets { _multigrid_levels[l]._descriptor_set_handles[0], _multigrid_levels[l + 1]._descriptor_set_handles[0] };
+            dispatch_multigrid(cmd_buff, _multigrid_restrict_pipeline_handle, _multigrid_restrict_pipeline_layout_handle, level_sets, level_pc, _multigrid_levels[l + 1]._extent);
+            compute_barrier(cmd_buff);
+        }
 
+        // Livello più grossolano: abbastanza piccolo da poter iterare molto
+        smooth_multigrid_level(cmd_buff, _multigrid_levels.size() - 1, MULTIGRID_COARSEST_ITERATIONS);
 
+        // Ramo ascendente della V: prolungamento della correzione e post-smoothing
+        for (size_t l = _multigrid_levels.size() - 1; l-- > 0;)
+        {
+            MultigridPushConstants level_pc { .h2 = _multigrid_levels[l]._h2, .omega = MULTIGRID_JACOBI_WEIGHT };
+            std::array<VkDescriptorSet, 2> level_sets { _multigrid_levels[l]._descriptor_set_handles[0], _multigrid_levels[l + 1]._descriptor_set_handles[0] };
+            dispatch_multigrid(cmd_buff, _multigrid_prolong_pipeline_handle, _multigrid_prolong_pipeline_layout_handle, level_sets, level_pc, _multigrid_levels[l]._extent);
+            compute_barrier(cmd_buff);
 
+            smooth_multigrid_level(cmd_buff, l, smoothing);
+        }
 
+        // Correzione della pressione a piena risoluzione e post-smoothing
+        dispatch_multigrid(cmd_buff, _multigrid_prolong_field_pipeline_handle, _multigrid_prolong_field_pipeline_layout_handle, field_sets, fine_pc, _draw_extent);
+        compute_barrier(cmd_buff);
 
+        run_jacobi_pressure(cmd_buff, pc, smoothing);
+    }
+}
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <deque>
 #include <filesystem>
@@ -11,6 +13,7 @@
 #include <span>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include <SDL2/SDL.h>
@@ -26,11 +29,18 @@
 #include "deletion_queue.hpp"
 #include "descriptor_allocator.hpp"
 #include "descriptor_layout_builder.hpp"
+#include "descriptor_writer.hpp"
+#include "engine_config.hpp"
+#include "gpu_profiler.hpp"
+#include "pipeline_cache.hpp"
+#include "readback_ring.hpp"
 #include "result_check.hpp"
+#include "snapshot.hpp"
 #include "spirv_data.hpp"
 #include "spirv_file_reader.hpp"
 #include "logger.hpp"
 #include "stopwatch.hpp"
+#include "workgroup_tuning.hpp"
 #include "input_handler.hpp"
 
 #define DEBUG_LEVEL 1
@@ -43,6 +53,7 @@ public:
     static constexpr std::string COMPONENT_NAME { "ENGINE" };
 
     Engine();
+    explicit Engine(const EngineConfig& config);
     static Engine& Get();
 
     void init();
@@ -50,13 +61,27 @@ public:
     void cleanup();
 
 private:
+    EngineConfig _config {};
+
     bool _initialized    {};
     bool _stop_rendering {};
     int  _frame_counter  {};
     bool _quit           {};
 
-    Stopwatch    _stopwatch     {};
-    InputHandler _input_handler {};
+    // Step di simulazione registrati finora; con i substep differisce da _frame_counter.
+    // Con --restore parte dal numero di step dello snapshot.
+    uint64_t _simulation_step_counter {};
+
+    // Il primo step transiziona i campi, li ripristina dallo snapshot e rasterizza gli ostacoli
+    bool _fields_initialized {};
+
+    // Tempo reale (ms) non ancora simulato dal passo fisso
+    double _simulation_accumulator {};
+
+    Stopwatch     _stopwatch      {};
+    InputHandler  _input_handler  {};
+    GpuProfiler   _gpu_profiler   {};
+    PipelineCache _pipeline_cache {};
 
     struct SDL_Window* _window_ptr {};
 
@@ -78,8 +103,14 @@ private:
     VkQueue  _graphics_queue_handle {};
     uint32_t _graphics_queue_family {};
 
-    VkDescriptorSet       _descriptor_set_0_handle      {};
-    VkDescriptorSet       _descriptor_set_1_handle      {};
+    // Coda che esegue la simulazione: quella grafica, a meno che l'async compute
+    // trovi una family di compute separata.
+    VkQueue  _compute_queue_handle {};
+    uint32_t _compute_queue_family {};
+
+    // Indicizzati per [immagine di velocità][immagine di pressione] lette come
+    // *_current: il binding *_next corrispondente è sempre l'altra della coppia.
+    VkDescriptorSet       _descriptor_set_handles[2][2] {};
     VkDescriptorSetLayout _descriptor_set_layout_handle {};
     DescriptorAllocator   _global_descriptor_allocator  {};
 
@@ -97,13 +128,54 @@ private:
         VkFormat      _image_format      {};
     };
 
-    std::vector<AllocatedImage> _images { 3 };
-    VkExtent2D _draw_extent {};
+    struct AllocatedBuffer
+    {
+        VkBuffer          _buffer_handle   {};
+        VmaAllocation     _allocation      {};
+        VmaAllocationInfo _allocation_info {};
+    };
+
+    // Campi della simulazione, ognuno con il proprio ping-pong:
+    // velocità rg32f e pressione r32f (rg16f e r16f con --fp16).
+    // _draw_image è l'immagine da presentare.
+    VkFormat       _velocity_format    {};
+    VkFormat       _pressure_format    {};
+    VkFormat       _draw_image_format  {};
+    AllocatedImage _velocity_images[2] {};
+    AllocatedImage _pressure_images[2] {};
+    AllocatedImage _draw_image         {};
+    AllocatedImage _obstacle_image     {};
+    VkExtent2D     _draw_extent        {};
+
+    // Indice dell'immagine che contiene il campo aggiornato (*_current);
+    // i pass che scrivono in *_next lo invertono invece di ricopiare l'immagine.
+    uint32_t _velocity_index {};
+    uint32_t _pressure_index {};
+
+    // Copia dei campi in uno slot del readback ring, da consegnare al suo
+    // thread quando il lavoro che la registra è concluso.
+    struct PendingReadback
+    {
+        uint32_t               _slot     {};
+        ReadbackRing::Consumer _consumer {};
+    };
 
     struct Frame
     {
         VkCommandPool   _command_pool_handle        {};
         VkCommandBuffer _command_buffer_handle      {};
+
+        // Solo async compute: il batch di simulazione registrato per questo frame.
+        VkCommandPool   _compute_command_pool_handle   {};
+        VkCommandBuffer _compute_command_buffer_handle {};
+        uint64_t        _simulation_timeline_value     {};
+
+        std::optional<PendingReadback> _pending_readback {};
+
+        // --log-residuals: step di questo frame che hanno scritto la sua fetta di _residual_history_buffer.
+        // Ogni step riscrive la stessa fetta, quindi resta solo lo storico dell'ultimo substep.
+        uint32_t _residual_history_steps {};
+
         VkSemaphore     _swapchain_semaphore_handle {};
         VkSemaphore     _render_semaphore_handle    {};
         VkFence         _render_fence_handle        {};
@@ -112,11 +184,78 @@ private:
 
     Frame _frames[FRAME_OVERLAP];
 
+    // Async compute: ogni batch di simulazione copia _draw_image in una delle due
+    // _display_images e segnala _simulation_timeline con il proprio numero; la
+    // grafica presenta l'ultimo batch concluso e segnala _present_timeline, che
+    // il batch successivo sulla stessa display image attende prima di sovrascriverla.
+    bool           _async_compute                    {};
+    VkSemaphore    _simulation_timeline_handle       {};
+    VkSemaphore    _present_timeline_handle          {};
+    uint64_t       _simulation_timeline_value        {};
+    uint64_t       _present_timeline_value           {};
+    AllocatedImage _display_images[2]                {};
+    uint64_t       _display_image_present_values[2]  {};
+
+    // Comandi fuori dal frame loop (checkpoint finale), sulla coda della simulazione
+    VkCommandPool   _immediate_command_pool_handle   {};
+    VkCommandBuffer _immediate_command_buffer_handle {};
+    VkFence         _immediate_fence_handle          {};
+
+    // Checkpoint/restart ed export dei campi
+    static constexpr uint32_t READBACK_SLOT_COUNT { FRAME_OVERLAP + 1 };
+
+    ReadbackRing                   _readback_ring          {};
+    std::optional<AllocatedBuffer> _restore_staging_buffer {};
+    uint64_t                       _last_checkpoint_step   {};
+    uint64_t                       _last_export_step       {};
+
+    // Specialization constants di tutti i pipeline di compute: il constant_id è
+    // l'indice del campo (4 byte ciascuno) e ogni shader ignora gli id che non dichiara.
+    struct SpecializationConstants
+    {
+        uint32_t workgroup_size_x       {}; // 0
+        uint32_t workgroup_size_y       {}; // 1
+        float    diffusion_rate         {}; // 2
+        float    obstacle_spheres[4][3] {}; // 3-14: x, y, raggio
+        int32_t  boundary_cells         {}; // 15
+        float    sor_omega              {}; // 16
+        uint32_t pcg_preconditioner     {}; // 17
+    };
+
+    static constexpr uint32_t SPECIALIZATION_CONSTANT_COUNT { sizeof(SpecializationConstants) / sizeof(uint32_t) };
+
+    // Parametri fissati nei pipeline al momento della creazione
+    static constexpr float   DIFFUSION_RATE         { 0.004f };
+    static constexpr float   OBSTACLE_SPHERES[4][3] { { 1100.0f, 500.0f, 100.0f }, { 1200.0f, 300.0f, 75.0f }, { 1400.0f, 500.0f, 120.0f }, { 1250.0f, 425.0f, 25.0f } };
+    static constexpr int32_t BOUNDARY_CELLS         { 10 };
+
+    // I kernel a blocchi dimensionano la memoria condivisa su una tile 16x16
+    static constexpr VkExtent2D TILED_WORKGROUP_SIZE { 16, 16 };
+
+    // Forme provate dall'autotuner per ogni kernel (quelle oltre i limiti del dispositivo
+    // vengono saltate) e dispatch cronometrati per ogni forma.
+    static constexpr std::array<VkExtent2D, 12> WORKGROUP_CANDIDATES
+    {{
+        { 8, 8 }, { 16, 8 }, { 8, 16 }, { 16, 16 }, { 32, 4 }, { 32, 8 },
+        { 32, 16 }, { 64, 1 }, { 64, 2 }, { 64, 4 }, { 128, 1 }, { 256, 1 }
+    }};
+
+    static constexpr uint32_t TUNING_DISPATCHES { 20 };
+
+    VkExtent2D      _workgroup_size   {};
+    WorkgroupTuning _workgroup_tuning {};
+
+    // Dimensione del workgroup con cui è stato specializzato ogni pipeline
+    std::unordered_map<VkPipeline, VkExtent2D> _pipeline_workgroup_sizes {};
+
     struct ComputePushConstants
     {
         uint32_t mouse_down   {};
-        uint32_t time_elapsed {};
+        float    delta_time   {};
         glm::ivec2 mouse_pos  {};
+
+        // Iterazioni svolte in memoria condivisa dai kernel *_tiled.
+        uint32_t block_iterations { 1 };
     };
 
     ////////
@@ -130,7 +269,17 @@ private:
     void init_sync_structures();
     void init_descriptor_sets();
     void init_images();
+    void init_pipeline_cache();
     void init_pipelines();
+    void init_gpu_profiler();
+    void init_snapshots();
+
+    AllocatedImage create_image(VkFormat format, VkExtent3D extent, VkImageUsageFlags usages, std::span<const uint32_t> queue_families = {});
+
+    AllocatedBuffer create_buffer(size_t size, VkBufferUsageFlags usages, VmaAllocationCreateFlags allocation_flags);
+    void destroy_buffer(const AllocatedBuffer& buffer);
+
+    void immediate_submit(std::function<void(VkCommandBuffer cmd_buff)>&& function);
 
     void create_swapchain(uint32_t width, uint32_t height);
     void destroy_swapchain();
@@ -156,7 +305,22 @@ private:
     std::string spv_directory_path();
 
     void draw();
+    void draw_async();
+    void submit_simulation_batch(uint32_t substeps);
+    uint32_t simulation_substeps();
+    void record_simulation_step(VkCommandBuffer cmd_buff);
+    void blit_to_swapchain(VkCommandBuffer cmd_buff, VkImage source, uint32_t swapchain_image_index);
+    void wait_timeline(VkSemaphore timeline_handle, uint64_t value);
+
+    bool checkpoint_due() const;
+    bool export_due() const;
+    void record_due_readbacks(VkCommandBuffer cmd_buff);
+    std::optional<PendingReadback> record_readback(VkCommandBuffer cmd_buff, bool checkpoint, bool field_export);
+    void consume_readback(std::optional<PendingReadback>& pending_readback);
+    void finish_readbacks();
+    void record_restore(VkCommandBuffer cmd_buff);
     void quit();
+    bool reached_max_steps() const;
 
     // fluid stuff
 
@@ -172,16 +336,294 @@ private:
     VkPipeline       _remove_divergency_pipeline_handle        {};
     VkPipelineLayout _remove_divergency_pipeline_layout_handle {};
 
-    VkPipeline       _swap_pipeline_handle        {};
-    VkPipelineLayout _swap_pipeline_layout_handle {};
+    // Rasterizza gli ostacoli nella maschera r8ui, una sola volta al primo frame
+    VkPipeline       _obstacles_pipeline_handle        {};
+    VkPipelineLayout _obstacles_pipeline_layout_handle {};
+
+    VkPipeline       _jacobi_diffusion_tiled_pipeline_handle        {};
+    VkPipelineLayout _jacobi_diffusion_tiled_pipeline_layout_handle {};
+
+    VkPipeline       _jacobi_pressure_tiled_pipeline_handle        {};
+    VkPipelineLayout _jacobi_pressure_tiled_pipeline_layout_handle {};
+
+    std::string field_shader_path(const std::string& shader_name) const;
+    VkDeviceSize image_size(const AllocatedImage& image) const;
+    void init_workgroup_size();
+    void init_compute_pipeline(VkPipeline& pipeline_handle, VkPipelineLayout& pipeline_layout_handle, const std::string& spv_path, std::optional<VkExtent2D> workgroup_size = std::nullopt);
+    void init_compute_pipeline( VkPipeline& pipeline_handle,
+                                VkPipelineLayout& pipeline_layout_handle,
+                                const std::string& spv_path,
+                                std::span<const VkDescriptorSetLayout> descriptor_set_layouts,
+                                uint32_t push_constants_size,
+                                std::optional<VkExtent2D> workgroup_size = std::nullopt );
+    VkPipeline create_compute_pipeline(VkPipelineLayout pipeline_layout_handle, const std::string& spv_path, VkExtent2D workgroup_size);
+    VkExtent2D pipeline_workgroup_size(VkPipeline pipeline_handle) const;
+    VkExtent2D kernel_workgroup_size(const std::string& kernel_name) const;
+    void autotune_workgroups();
+
+    VkDescriptorSet field_descriptor_set() const;
 
-    void init_compute_pipeline(VkPipeline& pipeline_handle, VkPipelineLayout& pipeline_layout_handle, const std::string& spv_path);
     void dispatch_compute(VkCommandBuffer cmd_buff, VkPipeline pipeline_handle, VkPipelineLayout pipeline_layout_handle, const ComputePushConstants& pc);
+    void compute_barrier(VkCommandBuffer cmd_buff);
+    glm::ivec2 grid_mouse_position() const;
     void compute_simulation_step(VkCommandBuffer cmd_buff);
+    void solve_pressure(VkCommandBuffer cmd_buff, const ComputePushConstants& pc, uint32_t solve_index);
+    void clear_field_image(VkCommandBuffer cmd_buff, const AllocatedImage& image);
+
+    void dispatch_grid(VkCommandBuffer cmd_buff, VkExtent2D extent, VkExtent2D workgroup_size);
+    int run_jacobi_solver( VkCommandBuffer cmd_buff,
+                           VkPipeline jacobi_pipeline_handle,
+                           VkPipelineLayout jacobi_pipeline_layout_handle,
+                           std::span<const VkDescriptorSet, 2> ping_pong_sets,
+                           const ComputePushConstants& pc,
+                           int iterations,
+                           uint32_t block_iterations = 1,
+                           bool residual_checks = false,
+                           std::optional<uint32_t> history_offset = std::nullopt );
+
+    static constexpr int DIFFUSION_ITERATIONS { 20 };
+
+    void run_jacobi_diffusion(VkCommandBuffer cmd_buff, const ComputePushConstants& pc, int iterations);
+    void run_jacobi_pressure(VkCommandBuffer cmd_buff, const ComputePushConstants& pc, int iterations, std::optional<uint32_t> solve_index = std::nullopt);
+
+    // Uscita anticipata del solver di Jacobi della pressione: jacobi_residual.comp
+    // riduce il residuo in questo buffer, jacobi_converged.comp azzera il dispatch
+    // indiretto quando scende sotto la tolleranza. Stesso layout degli shader (std430).
+    struct ResidualState
+    {
+        uint32_t                  max_residual     {};
+        uint32_t                  padding[3]       {};
+        VkDispatchIndirectCommand full_dispatch    {};
+        uint32_t                  full_padding     {};
+        VkDispatchIndirectCommand dispatch         {};
+        uint32_t                  dispatch_padding {};
+    };
+
+    static_assert(offsetof(ResidualState, full_dispatch) == 16 && offsetof(ResidualState, dispatch) == 32);
+
+    struct ResidualPushConstants
+    {
+        float    tolerance     {};
+        uint32_t history_index {};
+    };
+
+    // --log-residuals: jacobi_residual.comp gira anche dopo ogni dispatch e riduce in uno
+    // storico visibile all'host, una fetta per slot di frame e solve della pressione; la
+    // voce 0 è il residuo della soluzione iniziale. Il frame legge la sua fetta dopo il fence.
+    static constexpr uint32_t PRESSURE_SOLVES_PER_STEP { 2 };
+    static constexpr uint32_t MAX_RESIDUAL_HISTORY     { 64 };
+    static constexpr uint32_t NO_RESIDUAL_HISTORY      { UINT32_MAX };
+    static constexpr int      RESIDUAL_LOG_INTERVAL    { 120 };
+
+    bool                  _residual_checks                       {};
+    bool                  _residual_history                      {};
+    int                   _last_residual_log_frame               {};
+    AllocatedBuffer       _residual_buffer                       {};
+    AllocatedBuffer       _residual_history_buffer               {};
+    VkDescriptorSetLayout _residual_descriptor_set_layout_handle {};
+    DescriptorAllocator   _residual_descriptor_allocator         {};
+    VkDescriptorSet       _residual_descriptor_set_handle        {};
+
+    VkPipeline       _jacobi_residual_pipeline_handle         {};
+    VkPipelineLayout _jacobi_residual_pipeline_layout_handle  {};
+
+    VkPipeline       _jacobi_converged_pipeline_handle        {};
+    VkPipelineLayout _jacobi_converged_pipeline_layout_handle {};
+
+    void init_residual_checks();
+    void reset_residual_state(VkCommandBuffer cmd_buff, VkExtent2D workgroup_size, uint32_t history_offset);
+    void record_residual(VkCommandBuffer cmd_buff, VkDescriptorSet field_descriptor_set_handle, uint32_t history_index);
+    void record_residual_check(VkCommandBuffer cmd_buff, VkDescriptorSet field_descriptor_set_handle);
+    uint32_t residual_history_offset(uint32_t solve_index) const;
+    void consume_residual_history(Frame& frame);
+    std::string pressure_solver_name() const;
+
+    // advezione semi-lagrangiana tramite sampler: un set con un combined image sampler
+    // per immagine di velocità, legato come set 1 accanto al set dei campi con lo stesso indice
+
+    bool                  _sampled_advection                               {};
+    VkSampler             _velocity_sampler_handle                         {};
+    VkDescriptorSetLayout _advection_sampler_descriptor_set_layout_handle  {};
+    DescriptorAllocator   _advection_sampler_descriptor_allocator          {};
+    VkDescriptorSet       _advection_sampler_descriptor_set_handles[2]     {};
+
+    VkPipeline       _advection_sampled_pipeline_handle        {};
+    VkPipelineLayout _advection_sampled_pipeline_layout_handle {};
+
+    bool linear_filter_supported(VkFormat format) const;
+    void init_sampled_advection();
+
+    // advezione MacCormack: maccormack_predict.comp scrive la predizione semi-lagrangiana
+    // in _maccormack_predicted_image, maccormack_correct.comp la advette all'indietro e
+    // scrive la velocità corretta in velocity_next
+
+    AllocatedImage        _maccormack_predicted_image              {};
+    VkDescriptorSetLayout _maccormack_descriptor_set_layout_handle {};
+    DescriptorAllocator   _maccormack_descriptor_allocator         {};
+    VkDescriptorSet       _maccormack_descriptor_set_handle        {};
+
+    VkPipeline       _maccormack_predict_pipeline_handle        {};
+    VkPipelineLayout _maccormack_predict_pipeline_layout_handle {};
+
+    VkPipeline       _maccormack_correct_pipeline_handle        {};
+    VkPipelineLayout _maccormack_correct_pipeline_layout_handle {};
+
+    void init_maccormack();
+    void run_advection(VkCommandBuffer cmd_buff, const ComputePushConstants& pc);
+
+    // solver SOR red-black della pressione: in place sull'immagine corrente,
+    // due pass su mezza griglia (uno per colore) per iterazione
+
+    struct SorPushConstants
+    {
+        uint32_t parity {};
+    };
+
+    VkPipeline       _sor_pressure_pipeline_handle        {};
+    VkPipelineLayout _sor_pressure_pipeline_layout_handle {};
+
+    void run_sor_pressure(VkCommandBuffer cmd_buff, int iterations, std::optional<uint32_t> solve_index);
+
+    // solver della pressione a gradiente coniugato precondizionato: ogni passo
+    // dell'iterazione è un pass di compute, gli scalari restano in _pcg_state_buffer
+    // e i pass sono dispatch indiretti che pcg_reduce.comp svuota a convergenza.
+    struct PcgState
+    {
+        float                     rz               {};
+        float                     pq               {};
+        float                     alpha            {};
+        float                     beta             {};
+        float                     max_residual     {};
+        uint32_t                  padding[3]       {};
+        VkDispatchIndirectCommand dispatch         {};
+        uint32_t                  dispatch_padding {};
+        VkDispatchIndirectCommand reduce_dispatch  {};
+        uint32_t                  reduce_padding   {};
+    };
+
+    static_assert(offsetof(PcgState, dispatch) == 32 && offsetof(PcgState, reduce_dispatch) == 48);
+
+    struct PcgPushConstants
+    {
+        uint32_t phase         {};
+        uint32_t partial_count {};
+        float    tolerance     {};
+    };
+
+    // Fasi di pcg_reduce.comp
+    static constexpr uint32_t PCG_PHASE_START { 0 };
+    static constexpr uint32_t PCG_PHASE_ALPHA { 1 };
+    static constexpr uint32_t PCG_PHASE_BETA  { 2 };
+
+    // Le riduzioni in memoria condivisa sono dimensionate su 256 thread
+    static constexpr VkExtent2D PCG_WORKGROUP_SIZE        { 16, 16 };
+    static constexpr VkExtent2D PCG_REDUCE_WORKGROUP_SIZE { 256, 1 };
+
+    AllocatedBuffer       _pcg_state_buffer                 {};
+    AllocatedBuffer       _pcg_partials_buffer              {};
+    uint32_t              _pcg_partial_count                {};
+    AllocatedImage        _pcg_images[4]                    {}; // r, z, p, q
+    VkDescriptorSetLayout _pcg_descriptor_set_layout_handle {};
+    DescriptorAllocator   _pcg_descriptor_allocator         {};
+    VkDescriptorSet       _pcg_descriptor_set_handle        {};
+
+    VkPipeline       _pcg_init_pipeline_handle        {};
+    VkPipelineLayout _pcg_init_pipeline_layout_handle {};
+
+    VkPipeline       _pcg_precondition_pipeline_handle        {};
+    VkPipelineLayout _pcg_precondition_pipeline_layout_handle {};
+
+    VkPipeline       _pcg_spmv_pipeline_handle        {};
+    VkPipelineLayout _pcg_spmv_pipeline_layout_handle {};
+
+    VkPipeline       _pcg_reduce_pipeline_handle        {};
+    VkPipelineLayout _pcg_reduce_pipeline_layout_handle {};
+
+    VkPipeline       _pcg_update_pipeline_handle        {};
+    VkPipelineLayout _pcg_update_pipeline_layout_handle {};
+
+    VkPipeline       _pcg_direction_pipeline_handle        {};
+    VkPipelineLayout _pcg_direction_pipeline_layout_handle {};
+
+    void init_pcg();
+    void reset_pcg_state(VkCommandBuffer cmd_buff);
+    void run_pcg_solver(VkCommandBuffer cmd_buff, int iterations, std::optional<uint32_t> solve_index);
+    void dispatch_pcg(VkCommandBuffer cmd_buff, VkPipeline pipeline_handle, VkPipelineLayout pipeline_layout_handle, VkDeviceSize indirect_offset, uint32_t phase = PCG_PHASE_START);
+
+    // solver spettrale della pressione: trasformata in seni lungo x, poi lungo y con
+    // divisione per gli autovalori e trasformata inversa, infine inversa lungo x
+
+    struct FftPushConstants
+    {
+        uint32_t inverse {};
+    };
+
+    // Un workgroup per coppia di righe o colonne (fft_common.glsl)
+    static constexpr VkExtent2D FFT_WORKGROUP_SIZE { 256, 1 };
+
+    AllocatedImage        _fft_spectrum_image               {};
+    VkDescriptorSetLayout _fft_descriptor_set_layout_handle {};
+    DescriptorAllocator   _fft_descriptor_allocator         {};
+    VkDescriptorSet       _fft_descriptor_set_handle        {};
+
+    VkPipeline       _fft_rows_pipeline_handle        {};
+    VkPipelineLayout _fft_rows_pipeline_layout_handle {};
+
+    VkPipeline       _fft_columns_pipeline_handle        {};
+    VkPipelineLayout _fft_columns_pipeline_layout_handle {};
+
+    void init_fft();
+    void run_fft_solver(VkCommandBuffer cmd_buff, std::optional<uint32_t> solve_index);
+
+    // solver multigrid della pressione
+
+    struct MultigridPushConstants
+    {
+        float h2    {};
+        float omega {};
+    };
+
+    struct MultigridLevel
+    {
+        AllocatedImage  _error_images[2]           {};
+        AllocatedImage  _rhs_image                 {};
+        VkExtent2D      _extent                    {};
+        float           _h2                        {};
+        VkDescriptorSet _descriptor_set_handles[2] {};
+    };
+
+    static constexpr uint32_t MULTIGRID_COARSEST_SIZE       { 16 };
+    static constexpr uint32_t MULTIGRID_COARSEST_ITERATIONS { 20 };
+    static constexpr float    MULTIGRID_JACOBI_WEIGHT       { 0.8f };
+
+    // _multigrid_levels[0] è il primo livello grossolano, metà della griglia.
+    std::vector<MultigridLevel> _multigrid_levels                       {};
+    VkDescriptorSetLayout       _multigrid_descriptor_set_layout_handle {};
+    DescriptorAllocator         _multigrid_descriptor_allocator         {};
+
+    VkPipeline       _multigrid_restrict_field_pipeline_handle        {};
+    VkPipelineLayout _multigrid_restrict_field_pipeline_layout_handle {};
+
+    VkPipeline       _multigrid_restrict_pipeline_handle        {};
+    VkPipelineLayout _multigrid_restrict_pipeline_layout_handle {};
+
+    VkPipeline       _multigrid_smooth_pipeline_handle        {};
+    VkPipelineLayout _multigrid_smooth_pipeline_layout_handle {};
+
+    VkPipeline       _multigrid_prolong_pipeline_handle        {};
+    VkPipelineLayout _multigrid_prolong_pipeline_layout_handle {};
+
+    VkPipeline       _multigrid_prolong_field_pipeline_handle        {};
+    VkPipelineLayout _multigrid_prolong_field_pipeline_layout_handle {};
+
+    void init_multigrid();
+    void run_multigrid_solver(VkCommandBuffer cmd_buff, const ComputePushConstants& pc);
+    void smooth_multigrid_level(VkCommandBuffer cmd_buff, size_t level_index, uint32_t iterations);
 
-    void run_jacobi_solver( VkCommandBuffer cmd_buff,
-                            VkPipeline jacobi_pipeline_handle,
-                            VkPipelineLayout jacobi_pipeline_layout_handle,
-                            const ComputePushConstants& pc,
-                            int iterations );
+    void dispatch_multigrid( VkCommandBuffer cmd_buff,
+                             VkPipeline pipeline_handle,
+                             VkPipelineLayout pipeline_layout_handle,
+                             std::span<const VkDescriptorSet> descriptor_sets,
+                             const MultigridPushConstants& pc,
+                             VkExtent2D extent );
 };
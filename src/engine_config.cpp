@@ -0,0 +1,319 @@
+#include "engine_config.hpp"
+
+#include <bit>
+#include <tuple>
+#include <utility>
+
+static uint64_t parse_unsigned(const std::string& option, const std::string& value)
+{
+    try
+    {
+        size_t parsed_chars {};
+        unsigned long long parsed { std::stoull(value, &parsed_chars) };
+
+        if (parsed_chars != value.size() || value.front() == '-')
+            throw std::invalid_argument(value);
+
+        return parsed;
+    }
+    catch (const std::logic_error&)
+    {
+        throw std::runtime_error("Invalid value \"" + value + "\" for option " + option + ".");
+    }
+}
+
+static float parse_positive_float(const std::string& option, const std::string& value)
+{
+    try
+    {
+        size_t parsed_chars {};
+        float parsed { std::stof(value, &parsed_chars) };
+
+        if (parsed_chars != value.size() || !(parsed > 0.0f))
+            throw std::invalid_argument(value);
+
+        return parsed;
+    }
+    catch (const std::logic_error&)
+    {
+        throw std::runtime_error("Invalid value \"" + value + "\" for option " + option + ".");
+    }
+}
+
+// Legge una dimensione nel formato LARGHEZZAxALTEZZA, ad esempio 1024x512.
+static std::pair<uint32_t, uint32_t> parse_size(const std::string& option, const std::string& value)
+{
+    size_t separator { value.find('x') };
+
+    if (separator == std::string::npos)
+        throw std::runtime_error("Invalid value \"" + value + "\" for option " + option + ", expected WIDTHxHEIGHT.");
+
+    uint64_t width  { parse_unsigned(option, value.substr(0, separator)) };
+    uint64_t height { parse_unsigned(option, value.substr(separator + 1)) };
+
+    if (width == 0 || height == 0 || width > UINT32_MAX || height > UINT32_MAX)
+        throw std::runtime_error("Invalid value \"" + value + "\" for option " + option + ".");
+
+    return { (uint32_t)width, (uint32_t)height };
+}
+
+// Legge una cella della griglia nel formato X,Y, ad esempio 64,32.
+static std::pair<uint32_t, uint32_t> parse_cell(const std::string& option, const std::string& value)
+{
+    size_t separator { value.find(',') };
+
+    if (separator == std::string::npos)
+        throw std::runtime_error("Invalid value \"" + value + "\" for option " + option + ", expected X,Y.");
+
+    uint64_t x { parse_unsigned(option, value.substr(0, separator)) };
+    uint64_t y { parse_unsigned(option, value.substr(separator + 1)) };
+
+    if (x > UINT32_MAX || y > UINT32_MAX)
+        throw std::runtime_error("Invalid value \"" + value + "\" for option " + option + ".");
+
+    return { (uint32_t)x, (uint32_t)y };
+}
+
+static PressureSolver parse_pressure_solver(const std::string& option, const std::string& value)
+{
+    if (value == "jacobi")
+        return PressureSolver::JACOBI;
+    if (value == "multigrid")
+        return PressureSolver::MULTIGRID;
+    if (value == "sor")
+        return PressureSolver::SOR;
+    if (value == "pcg")
+        return PressureSolver::PCG;
+    if (value == "fft")
+        return PressureSolver::FFT;
+
+    throw std::runtime_error("Invalid value \"" + value + "\" for option " + option + ".");
+}
+
+static PcgPreconditioner parse_pcg_preconditioner(const std::string& option, const std::string& value)
+{
+    if (value == "jacobi")
+        return PcgPreconditioner::JACOBI;
+    if (value == "ip")
+        return PcgPreconditioner::INCOMPLETE_POISSON;
+
+    throw std::runtime_error("Invalid value \"" + value + "\" for option " + option + ".");
+}
+
+static AdvectionScheme parse_advection(const std::string& option, const std::string& value)
+{
+    if (value == "semi-lagrangian")
+        return AdvectionScheme::SEMI_LAGRANGIAN;
+    if (value == "maccormack")
+        return AdvectionScheme::MACCORMACK;
+
+    throw std::runtime_error("Invalid value \"" + value + "\" for option " + option + ".");
+}
+
+static Backend parse_backend(const std::string& option, const std::string& value)
+{
+    if (value == "gpu")
+        return Backend::GPU;
+    if (value == "cpu")
+        return Backend::CPU;
+
+    throw std::runtime_error("Invalid value \"" + value + "\" for option " + option + ".");
+}
+
+EngineConfig EngineConfig::from_args(int argc, char* argv[])
+{
+    EngineConfig config {};
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string option { argv[i] };
+
+        // Restituisce il valore che segue l'opzione corrente.
+        auto next_value = [&]() -> std::string
+        {
+            if (i + 1 >= argc)
+                throw std::runtime_error("Missing value for option " + option + ".");
+
+            return argv[++i];
+        };
+
+        if (option == "--headless")
+            config.headless = { true };
+        else if (option == "--backend")
+            config.backend = { parse_backend(option, next_value()) };
+        else if (option == "--threads")
+            config.cpu_threads = { static_cast<uint32_t>(parse_unsigned(option, next_value())) };
+        else if (option == "--grid")
+            std::tie(config.grid_width, config.grid_height) = parse_size(option, next_value());
+        else if (option == "--window")
+            std::tie(config.window_width, config.window_height) = parse_size(option, next_value());
+        else if (option == "--no-obstacles")
+            config.obstacles = { false };
+        else if (option == "--inject")
+        {
+            config.inject = { true };
+            std::tie(config.inject_x, config.inject_y) = parse_cell(option, next_value());
+        }
+        else if (option == "--workgroup")
+            std::tie(config.workgroup_width, config.workgroup_height) = parse_size(option, next_value());
+        else if (option == "--autotune")
+            config.autotune_workgroups = { true };
+        else if (option == "--workgroup-tuning")
+            config.workgroup_tuning_path = { next_value() };
+        else if (option == "--no-workgroup-tuning")
+            config.workgroup_tuning_path.clear();
+        else if (option == "--steps")
+            config.max_steps = { parse_unsigned(option, next_value()) };
+        else if (option == "--pressure-solver")
+            config.pressure_solver = { parse_pressure_solver(option, next_value()) };
+        else if (option == "--pressure-iterations")
+            config.pressure_iterations = { static_cast<uint32_t>(parse_unsigned(option, next_value())) };
+        else if (option == "--cold-start")
+            config.pressure_warm_start = { false };
+        else if (option == "--log-residuals")
+            config.log_residuals = { true };
+        else if (option == "--pressure-tolerance")
+            config.pressure_tolerance = { parse_positive_float(option, next_value()) };
+        else if (option == "--residual-every")
+            config.residual_check_interval = { static_cast<uint32_t>(parse_unsigned(option, next_value())) };
+        else if (option == "--sor-omega")
+            config.sor_omega = { parse_positive_float(option, next_value()) };
+        else if (option == "--pcg-preconditioner")
+            config.pcg_preconditioner = { parse_pcg_preconditioner(option, next_value()) };
+        else if (option == "--mg-cycles")
+            config.multigrid_cycles = { static_cast<uint32_t>(parse_unsigned(option, next_value())) };
+        else if (option == "--mg-smoothing")
+            config.multigrid_smoothing = { static_cast<uint32_t>(parse_unsigned(option, next_value())) };
+        else if (option == "--jacobi-block")
+            config.jacobi_block_iterations = { static_cast<uint32_t>(parse_unsigned(option, next_value())) };
+        else if (option == "--advection")
+            config.advection = { parse_advection(option, next_value()) };
+        else if (option == "--sampled-advection")
+            config.sampled_advection = { true };
+        else if (option == "--async-compute")
+            config.async_compute = { true };
+        else if (option == "--steps-per-frame")
+            config.steps_per_frame = { static_cast<uint32_t>(parse_unsigned(option, next_value())) };
+        else if (option == "--dt")
+            config.fixed_delta_time = { parse_positive_float(option, next_value()) };
+        else if (option == "--max-substeps")
+            config.max_substeps = { static_cast<uint32_t>(parse_unsigned(option, next_value())) };
+        else if (option == "--profile")
+            config.gpu_profiling = { true };
+        else if (option == "--checkpoint")
+            config.checkpoint_path = { next_value() };
+        else if (option == "--checkpoint-every")
+            config.checkpoint_interval = { parse_unsigned(option, next_value()) };
+        else if (option == "--export")
+            config.export_path = { next_value() };
+        else if (option == "--export-every")
+            config.export_interval = { parse_unsigned(option, next_value()) };
+        else if (option == "--restore")
+            config.restore_path = { next_value() };
+        else if (option == "--fp16")
+            config.half_precision = { true };
+        else if (option == "--compare")
+        {
+            config.compare_reference_path = { next_value() };
+            config.compare_path           = { next_value() };
+        }
+        else if (option == "--pipeline-cache")
+            config.pipeline_cache_path = { next_value() };
+        else if (option == "--no-pipeline-cache")
+            config.pipeline_cache_path.clear();
+        else
+            throw std::runtime_error("Unknown option \"" + option + "\".");
+    }
+
+    bool grid_in_range
+    {
+        config.grid_width  >= MIN_GRID_SIZE && config.grid_width  <= MAX_GRID_SIZE &&
+        config.grid_height >= MIN_GRID_SIZE && config.grid_height <= MAX_GRID_SIZE
+    };
+
+    if (!grid_in_range)
+        throw std::runtime_error("Option --grid must be between " + std::to_string(MIN_GRID_SIZE) + " and " + std::to_string(MAX_GRID_SIZE) + " cells per side.");
+
+    if (config.inject && (config.inject_x >= config.grid_width || config.inject_y >= config.grid_height))
+        throw std::runtime_error("Option --inject must name a cell inside the grid.");
+
+    if (config.jacobi_block_iterations < 1 || config.jacobi_block_iterations > MAX_JACOBI_BLOCK_ITERATIONS)
+        throw std::runtime_error("Option --jacobi-block must be between 1 and " + std::to_string(MAX_JACOBI_BLOCK_ITERATIONS) + ".");
+
+    if (!config.export_path.empty() && config.export_interval < 1)
+        throw std::runtime_error("Option --export-every must be at least 1.");
+
+    if (config.pressure_iterations < 1)
+        throw std::runtime_error("Option --pressure-iterations must be at least 1.");
+
+    if (config.residual_check_interval < 1)
+        throw std::runtime_error("Option --residual-every must be at least 1.");
+
+    if (!(config.sor_omega < 2.0f))
+        throw std::runtime_error("Option --sor-omega must be between 0 and 2.");
+
+    if (config.pressure_solver == PressureSolver::FFT)
+    {
+        // La DST-I di n valori è una FFT di 2 (n + 1) valori: n + 1 deve essere una potenza di due
+        auto fft_side = [](uint32_t side) { return std::has_single_bit(side + 1) && 2 * (side + 1) <= MAX_FFT_LENGTH; };
+
+        if (config.obstacles)
+            throw std::runtime_error("Option --pressure-solver fft needs an empty obstacle mask, add --no-obstacles.");
+
+        if (!fft_side(config.grid_width) || !fft_side(config.grid_height))
+            throw std::runtime_error("Option --pressure-solver fft needs grid sides of 2^k - 1 cells, at most " + std::to_string(MAX_FFT_LENGTH / 2 - 1) + " (e.g. --grid 1023x511).");
+    }
+
+    if (config.max_substeps < 1)
+        throw std::runtime_error("Option --max-substeps must be at least 1.");
+
+    // Un numero pari di iterazioni riporta il ping-pong sull'immagine di partenza.
+    config.multigrid_smoothing += config.multigrid_smoothing % 2;
+
+    return config;
+}
+
+std::string EngineConfig::usage()
+{
+    return
+        "Usage: dedalo_engine [options]\n"
+        "  --headless                 run the simulation without window, surface and swapchain\n"
+        "  --backend NAME             gpu | cpu, the CPU reference solver (default: gpu)\n"
+        "  --threads N                CPU backend threads (default: 0 = all hardware threads)\n"
+        "  --grid WxH                 simulation grid in cells, independent of the window (default: 2560x1080)\n"
+        "  --window WxH               window size in pixels (default: 2560x1080)\n"
+        "  --no-obstacles             no spheres and walls: empty obstacle mask (needed by the fft solver)\n"
+        "  --inject X,Y               push the flow at grid cell X,Y every step, as a held mouse button\n"
+        "  --workgroup WxH            compute workgroup size, e.g. 8x8, 32x8, 64x1 (default: 16x16)\n"
+        "  --autotune                 time the candidate workgroup shapes of each kernel and keep the fastest\n"
+        "  --workgroup-tuning PATH    workgroup tuning file (default: cache/workgroup_tuning.bin)\n"
+        "  --no-workgroup-tuning      ignore saved workgroup tuning and do not save it\n"
+        "  --steps N                  quit after N simulation steps (0 = unlimited)\n"
+        "  --pressure-solver NAME     jacobi | multigrid | sor | pcg | fft (default: jacobi)\n"
+        "  --pressure-iterations N    jacobi, sor or pcg iterations per pressure solve, two solves per step (default: 20)\n"
+        "  --cold-start               clear the pressure before every solve instead of reusing the last one\n"
+        "  --log-residuals            periodically log the Jacobi pressure residual after every dispatch\n"
+        "  --pressure-tolerance T     stop a jacobi or pcg pressure solve when no cell changes by more than T\n"
+        "  --residual-every K         Jacobi dispatches between two residual checks (default: 4)\n"
+        "  --sor-omega W              over-relaxation factor of the sor solver, between 0 and 2 (default: 1.7)\n"
+        "  --pcg-preconditioner NAME  jacobi | ip, incomplete Poisson (default: ip)\n"
+        "  --mg-cycles N              multigrid V-cycles per pressure solve (default: 2)\n"
+        "  --mg-smoothing N           smoothing sweeps per level, rounded up to even (default: 2)\n"
+        "  --jacobi-block K           Jacobi iterations per dispatch in shared memory, 1-4 (default: 1)\n"
+        "  --advection NAME           semi-lagrangian | maccormack, second order (default: semi-lagrangian)\n"
+        "  --sampled-advection        semi-lagrangian advection through a linear filtering sampler\n"
+        "  --async-compute            run the simulation on a compute queue, decoupled from the present\n"
+        "  --dt MS                    fixed simulation time step in milliseconds (default: 16)\n"
+        "  --steps-per-frame N        fixed simulation steps per frame (default: 0 = follow the wall clock)\n"
+        "  --max-substeps N           cap on the steps per frame when following the wall clock (default: 4)\n"
+        "  --profile                  log per-pass GPU times (min/avg/p99 in microseconds)\n"
+        "  --checkpoint PATH          save the velocity and pressure fields to PATH when quitting\n"
+        "  --checkpoint-every N       also save the checkpoint every N simulation steps\n"
+        "  --export DIR               export the velocity and pressure fields to DIR for offline analysis\n"
+        "  --export-every N           steps between two exports (default: 100)\n"
+        "  --restore PATH             resume from a snapshot written by --checkpoint\n"
+        "  --fp16                     store the fields at half precision (arithmetic stays fp32)\n"
+        "  --compare REF PATH         log the error of snapshot PATH against snapshot REF and quit\n"
+        "  --pipeline-cache PATH      pipeline cache file (default: cache/pipeline_cache.bin)\n"
+        "  --no-pipeline-cache        compile every pipeline from SPIR-V, without cache\n";
+}
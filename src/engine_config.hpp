@@ -0,0 +1,197 @@
+#ifndef ENGINE_CONFIG_HPP
+#define ENGINE_CONFIG_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+enum class PressureSolver
+{
+    JACOBI,
+    MULTIGRID,
+    SOR,
+    PCG,
+    FFT
+};
+
+enum class PcgPreconditioner
+{
+    JACOBI,
+    INCOMPLETE_POISSON
+};
+
+enum class AdvectionScheme
+{
+    SEMI_LAGRANGIAN,
+    MACCORMACK
+};
+
+enum class Backend
+{
+    GPU,
+    CPU
+};
+
+// Opzioni di avvio del motore, lette dalla riga di comando.
+struct EngineConfig
+{
+    // Niente finestra SDL, surface e swapchain: la simulazione viene
+    // inviata di seguito senza attendere il vsync.
+    bool headless {};
+
+    // GPU esegue il motore Vulkan, CPU il solver di riferimento multithread (cpu_solver.hpp).
+    Backend backend { Backend::GPU };
+
+    // Thread del backend CPU, chiamante compreso (0 = tutti i thread hardware).
+    uint32_t cpu_threads {};
+
+    // Dimensione della griglia, comune ai due backend. Non dipende dalla finestra:
+    // il blit finale adatta l'immagine da presentare alla swapchain.
+    uint32_t grid_width  { 2560 };
+    uint32_t grid_height { 1080 };
+
+    static constexpr uint32_t MIN_GRID_SIZE { 64 };
+    static constexpr uint32_t MAX_GRID_SIZE { 8192 };
+
+    // Sfere e bordi di obstacles.comp; senza, la maschera degli ostacoli è vuota.
+    bool obstacles { true };
+
+    // Forza applicata in ogni step alla cella (inject_x, inject_y) della griglia, come
+    // il mouse tenuto premuto lì: in modalità headless non c'è input e senza una
+    // forzante i campi restano a zero. Uguale per i due backend, quindi deterministica.
+    bool     inject   {};
+    uint32_t inject_x {};
+    uint32_t inject_y {};
+
+    // Dimensione della finestra in pixel (ignorata in modalità headless).
+    uint32_t window_width  { 2560 };
+    uint32_t window_height { 1080 };
+
+    // Dimensione del workgroup dei kernel di compute, applicata tramite
+    // specialization constants (i kernel *_tiled usano sempre 16x16).
+    uint32_t workgroup_width  { 16 };
+    uint32_t workgroup_height { 16 };
+
+    // All'avvio cronometra ogni forma di workgroup candidata dei kernel principali
+    // e tiene la più veloce per kernel. Il risultato viene salvato in
+    // workgroup_tuning_path (per dispositivo, driver, griglia e precisione) e
+    // riusato dalle esecuzioni successive; un percorso vuoto disabilita il file.
+    bool                  autotune_workgroups   {};
+    std::filesystem::path workgroup_tuning_path { "cache/workgroup_tuning.bin" };
+
+    // Step di simulazione da eseguire prima di uscire (0 = illimitati).
+    uint64_t max_steps {};
+
+    PressureSolver pressure_solver { PressureSolver::JACOBI };
+
+    // Iterazioni di ciascuno dei due solve della pressione per step (Jacobi, o SOR
+    // red-black dove un'iterazione è una mezza passata rossa e una nera). Per il PCG
+    // è il massimo: la GPU si ferma prima se il residuo scende sotto pressure_tolerance.
+    uint32_t pressure_iterations { 20 };
+
+    // Ogni solve della pressione parte da quella lasciata dal precedente (stesso
+    // step o step prima), già vicina alla soluzione. Il cold start la azzera invece
+    // prima di ogni solve, per misurare quanto fa risparmiare il warm start.
+    bool pressure_warm_start { true };
+
+    // Logga periodicamente il residuo dei solve della pressione dopo ogni dispatch
+    // (o iterazione), a partire dalla soluzione iniziale (richiede le operazioni
+    // aritmetiche di subgroup).
+    bool log_residuals {};
+
+    // I solve di Jacobi della pressione si fermano appena un'iterazione non
+    // cambierebbe nessuna cella più di pressure_tolerance (0 = sempre tutte le
+    // iterazioni). Il residuo è calcolato sulla GPU ogni residual_check_interval
+    // dispatch e i dispatch rimanenti diventano dispatch indiretti vuoti, senza
+    // attendere la CPU. Il PCG applica la stessa tolleranza dopo ogni iterazione.
+    float    pressure_tolerance      {};
+    uint32_t residual_check_interval { 4 };
+
+    // Fattore di sovrarilassamento del solver SOR red-black, in (0, 2): 1 è
+    // Gauss-Seidel, valori maggiori spingono ogni cella oltre il suo aggiornamento.
+    float sor_omega { 1.7f };
+
+    // Il solver fft inverte esattamente l'equazione della pressione con trasformate
+    // in seni calcolate come FFT di lunghezza 2 (lato + 1) in memoria condivisa:
+    // richiede la maschera degli ostacoli vuota e lati di 2^k - 1 celle, fino a
+    // MAX_FFT_LENGTH / 2 - 1.
+    static constexpr uint32_t MAX_FFT_LENGTH { 2048 };
+
+    // Precondizionatore del gradiente coniugato: Jacobi (la diagonale) o incomplete
+    // Poisson, un'inversa approssimata applicata come un solo stencil simmetrico.
+    PcgPreconditioner pcg_preconditioner { PcgPreconditioner::INCOMPLETE_POISSON };
+
+    // V-cycle per solve della pressione e passate di Jacobi smorzato prima e dopo
+    // ogni correzione dal livello grossolano (pari, così il ping-pong dei livelli
+    // finisce sull'immagine di partenza).
+    uint32_t multigrid_cycles    { 2 };
+    uint32_t multigrid_smoothing { 2 };
+
+    // Iterazioni di Jacobi per dispatch: valori oltre 1 scelgono i kernel in memoria
+    // condivisa (jacobi_*_tiled.comp), che arrivano a MAX_JACOBI_BLOCK_ITERATIONS.
+    uint32_t jacobi_block_iterations { 1 };
+
+    static constexpr uint32_t MAX_JACOBI_BLOCK_ITERATIONS { 4 };
+
+    // Advezione della velocità: semi-lagrangiana del primo ordine, o MacCormack, che
+    // advette avanti e indietro e corregge la predizione con metà dell'errore di
+    // andata e ritorno (limitata alle celle interpolate). MacCormack costa un pass e
+    // un campo in più ma diffonde molto meno, quindi una griglia più piccola
+    // conserva lo stesso dettaglio.
+    AdvectionScheme advection { AdvectionScheme::SEMI_LAGRANGIAN };
+
+    // L'advezione semi-lagrangiana legge la velocità tramite un sampler con filtro
+    // lineare (advection_sampled.comp): una fetch per cella invece di quattro load e
+    // due mix. Se il formato della velocità non supporta il filtro lineare si torna
+    // alle load.
+    bool sampled_advection {};
+
+    // Simulazione inviata su una queue family di compute separata e sincronizzata
+    // con il present tramite timeline semaphore: ogni frame mostra l'ultimo step
+    // concluso invece di attendere quello appena inviato.
+    bool async_compute {};
+
+    // Passo temporale fisso in millisecondi: ogni step fa avanzare la simulazione
+    // della stessa quantità, qualunque sia il frame rate.
+    float fixed_delta_time { 16.0f };
+
+    // Step registrati per frame. 0 li ricava dal tempo reale con un accumulatore,
+    // limitato a max_substeps perché un frame lento non inneschi una valanga.
+    uint32_t steps_per_frame {};
+    uint32_t max_substeps    { 4 };
+
+    // Timestamp query attorno a ogni pass dello step, con min/avg/p99 su una
+    // finestra mobile loggati periodicamente e alla fine dell'esecuzione.
+    bool gpu_profiling {};
+
+    // Checkpoint dei campi di velocità e pressione, scritto ogni
+    // checkpoint_interval step (0 = solo alla fine) e all'uscita.
+    // Un percorso vuoto disabilita i checkpoint.
+    std::filesystem::path checkpoint_path     {};
+    uint64_t              checkpoint_interval {};
+
+    // Directory che riceve uno snapshot dei campi ogni export_interval step, letto
+    // senza fermare il frame loop. Un percorso vuoto disabilita l'export.
+    std::filesystem::path export_path     {};
+    uint64_t              export_interval { 100 };
+
+    // Snapshot da cui riprendere; un file mancante o non valido fa partire da zero.
+    std::filesystem::path restore_path {};
+
+    // Campi salvati come rg16f/r16f (e l'immagine da presentare come rgba16f)
+    // invece che a 32 bit: metà traffico di memoria per pass, calcoli sempre fp32.
+    bool half_precision {};
+
+    // Due snapshot da confrontare (es. fp16 contro fp32) invece di eseguire la simulazione.
+    std::filesystem::path compare_reference_path {};
+    std::filesystem::path compare_path           {};
+
+    // Pipeline cache riusata fra le esecuzioni; un percorso vuoto la disabilita.
+    std::filesystem::path pipeline_cache_path { "cache/pipeline_cache.bin" };
+
+    static EngineConfig from_args(int argc, char* argv[]);
+    static std::string usage();
+};
+
+#endif // ENGINE_CONFIG_HPP
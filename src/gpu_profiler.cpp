@@ -0,0 +1,206 @@
+#include "gpu_profiler.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+#include <sstream>
+
+#include "logger.hpp"
+#include "result_check.hpp"
+
+void GpuProfiler::init(VkDevice device, VkPhysicalDevice physical_device, uint32_t queue_family, uint32_t frame_count)
+{
+    uint32_t family_count {};
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+
+    uint32_t valid_bits { queue_family < family_count ? families[queue_family].timestampValidBits : 0 };
+
+    if (valid_bits == 0)
+    {
+        LOG("The queue does not support timestamps, GPU profiling disabled.", COMPONENT_NAME, LogLevel::WARNING);
+        return;
+    }
+
+    VkPhysicalDeviceProperties properties {};
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+    // timestampPeriod: nanosecondi per tick del contatore
+    _timestamp_period = { properties.limits.timestampPeriod };
+    _timestamp_mask   = { valid_bits >= 64 ? ~uint64_t {} : (uint64_t { 1 } << valid_bits) - 1 };
+
+    VkQueryPoolCreateInfo query_pool_create_info {};
+    query_pool_create_info.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    query_pool_create_info.pNext      = nullptr;
+    query_pool_create_info.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+    query_pool_create_info.queryCount = MAX_PASSES_PER_FRAME * 2;
+
+    _frames.resize(frame_count);
+
+    for (FrameQueries& frame : _frames)
+        result_check(vkCreateQueryPool(device, &query_pool_create_info, nullptr, &frame._query_pool_handle));
+
+    _enabled = { true };
+}
+
+void GpuProfiler::destroy(VkDevice device)
+{
+    for (FrameQueries& frame : _frames)
+        vkDestroyQueryPool(device, frame._query_pool_handle, nullptr);
+
+    _frames.clear();
+    _current_frame = { nullptr };
+    _enabled       = { false };
+}
+
+bool GpuProfiler::enabled() const
+{
+    return _enabled;
+}
+
+void GpuProfiler::begin_frame(VkDevice device, VkCommandBuffer cmd_buff, uint32_t frame_slot)
+{
+    if (!_enabled)
+        return;
+
+    FrameQueries& frame { _frames[frame_slot % _frames.size()] };
+
+    collect(device, frame);
+
+    vkCmdResetQueryPool(cmd_buff, frame._query_pool_handle, 0, MAX_PASSES_PER_FRAME * 2);
+
+    _current_frame = { &frame };
+    _open_pass.reset();
+}
+
+void GpuProfiler::begin_pass(VkCommandBuffer cmd_buff, const std::string& name)
+{
+    if (!_enabled || _current_frame == nullptr || _open_pass)
+        return;
+
+    uint32_t query { (uint32_t)_current_frame->_pass_indices.size() * 2 };
+
+    if (query >= MAX_PASSES_PER_FRAME * 2)
+        return;
+
+    // Il timestamp viene scritto quando il lavoro di compute precedente è concluso.
+    vkCmdWriteTimestamp2(cmd_buff, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, _current_frame->_query_pool_handle, query);
+
+    _open_pass = { pass_index(name) };
+}
+
+void GpuProfiler::end_pass(VkCommandBuffer cmd_buff)
+{
+    if (!_open_pass)
+        return;
+
+    uint32_t query { (uint32_t)_current_frame->_pass_indices.size() * 2 + 1 };
+
+    vkCmdWriteTimestamp2(cmd_buff, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, _current_frame->_query_pool_handle, query);
+
+    // Solo le coppie complete vengono lette da collect().
+    _current_frame->_pass_indices.push_back(*_open_pass);
+    _open_pass.reset();
+}
+
+uint32_t GpuProfiler::pass_index(const std::string& name)
+{
+    for (uint32_t i = 0; i < _passes.size(); ++i)
+    {
+        if (_passes[i]._name == name)
+            return i;
+    }
+
+    _passes.push_back(Pass { ._name = name });
+    return (uint32_t)_passes.size() - 1;
+}
+
+void GpuProfiler::collect(VkDevice device, FrameQueries& frame)
+{
+    if (frame._pass_indices.empty())
+        return;
+
+    uint32_t query_count { (uint32_t)frame._pass_indices.size() * 2 };
+    std::vector<uint64_t> timestamps(query_count);
+
+    // Il fence di questo frame è già stato atteso: WAIT_BIT non blocca.
+    VkResult result
+    {
+        vkGetQueryPoolResults
+        (
+            device,
+            frame._query_pool_handle,
+            0,
+            query_count,
+            timestamps.size() * sizeof(uint64_t),
+            timestamps.data(),
+            sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT
+        )
+    };
+
+    if (result == VK_SUCCESS)
+    {
+        for (size_t i = 0; i < frame._pass_indices.size(); ++i)
+        {
+            // La maschera gestisce anche il wrap-around dei contatori con meno di 64 bit validi.
+            uint64_t ticks { (timestamps[i * 2 + 1] - timestamps[i * 2]) & _timestamp_mask };
+
+            Pass& pass { _passes[frame._pass_indices[i]] };
+            pass._durations_us.push_back(ticks * _timestamp_period / 1000.0);
+
+            if (pass._durations_us.size() > HISTORY_SIZE)
+                pass._durations_us.pop_front();
+        }
+    }
+
+    frame._pass_indices.clear();
+}
+
+std::vector<GpuProfiler::PassStats> GpuProfiler::stats() const
+{
+    std::vector<PassStats> result {};
+    result.reserve(_passes.size());
+
+    for (const Pass& pass : _passes)
+    {
+        if (pass._durations_us.empty())
+            continue;
+
+        std::vector<double> sorted { pass._durations_us.begin(), pass._durations_us.end() };
+        std::sort(sorted.begin(), sorted.end());
+
+        // p99 con il metodo nearest-rank
+        size_t p99_rank { (sorted.size() * 99 + 99) / 100 };
+
+        PassStats pass_stats {};
+        pass_stats.name    = { pass._name };
+        pass_stats.min_us  = { sorted.front() };
+        pass_stats.avg_us  = { std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size() };
+        pass_stats.p99_us  = { sorted[p99_rank - 1] };
+        pass_stats.samples = { sorted.size() };
+
+        result.push_back(pass_stats);
+    }
+
+    return result;
+}
+
+std::string GpuProfiler::report() const
+{
+    std::ostringstream stream {};
+    stream << std::fixed << std::setprecision(1);
+    stream << "GPU pass times in us (min / avg / p99 over the last " << HISTORY_SIZE << " frames):";
+
+    for (const PassStats& pass : stats())
+    {
+        stream << "\n  " << std::left << std::setw(22) << pass.name << std::right
+               << std::setw(10) << pass.min_us
+               << std::setw(10) << pass.avg_us
+               << std::setw(10) << pass.p99_us;
+    }
+
+    return stream.str();
+}
@@ -0,0 +1,74 @@
+#ifndef GPU_PROFILER_HPP
+#define GPU_PROFILER_HPP
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Misura la durata dei pass di compute con timestamp GPU. Ogni frame in volo
+// ha il suo query pool: i risultati si leggono quando il fence di quel frame
+// è già stato atteso (FRAME_OVERLAP frame dopo), quindi senza stalli.
+class GpuProfiler {
+public:
+    static constexpr std::string COMPONENT_NAME { "GPU_PROFILER" };
+
+    // Timestamp pairs recorded per frame and samples kept for the rolling statistics.
+    static constexpr uint32_t MAX_PASSES_PER_FRAME { 64 };
+    static constexpr size_t   HISTORY_SIZE         { 240 };
+
+    struct PassStats
+    {
+        std::string name    {};
+        double      min_us  {};
+        double      avg_us  {};
+        double      p99_us  {};
+        size_t      samples {};
+    };
+
+    void init(VkDevice device, VkPhysicalDevice physical_device, uint32_t queue_family, uint32_t frame_count);
+    void destroy(VkDevice device);
+
+    bool enabled() const;
+
+    // Reads back the timestamps written the last time frame_slot was recorded,
+    // then resets its queries. Call after the frame fence wait, at the start of cmd_buff.
+    void begin_frame(VkDevice device, VkCommandBuffer cmd_buff, uint32_t frame_slot);
+
+    void begin_pass(VkCommandBuffer cmd_buff, const std::string& name);
+    void end_pass(VkCommandBuffer cmd_buff);
+
+    std::vector<PassStats> stats() const;
+    std::string report() const;
+
+private:
+    struct Pass
+    {
+        std::string        _name         {};
+        std::deque<double> _durations_us {};
+    };
+
+    struct FrameQueries
+    {
+        VkQueryPool           _query_pool_handle {};
+        std::vector<uint32_t> _pass_indices      {};
+    };
+
+    bool     _enabled          {};
+    double   _timestamp_period {};
+    uint64_t _timestamp_mask   {};
+
+    std::vector<FrameQueries> _frames        {};
+    FrameQueries*             _current_frame {};
+    std::optional<uint32_t>   _open_pass     {};
+
+    // Pass in ordine di prima registrazione, così il report segue il frame.
+    std::vector<Pass> _passes {};
+
+    uint32_t pass_index(const std::string& name);
+    void collect(VkDevice device, FrameQueries& frame);
+};
+
+#endif // GPU_PROFILER_HPP
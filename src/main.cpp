@@ -1,24 +1,27 @@
+#include <fstream>
+
+#include "cpu_solver.hpp"
 #include "engine.hpp"
+#include "engine_config.hpp"
 #include "logger.hpp"
-#include "shader_compiler.hpp"
+#include "snapshot.hpp"
 
 int main(int argc, char* argv[])
 {
-    const std::filesystem::path shaders_directory_path = std::filesystem::current_path() / "shaders";
-    const std::filesystem::path spv_directory_path     = std::filesystem::current_path() / "shaders" / "spv";
-    const std::filesystem::path header_file_path       = std::filesystem::current_path() / "strings" / "header.txt";
+    const std::filesystem::path header_file_path = std::filesystem::current_path() / "strings" / "header.txt";
+
+    EngineConfig config {};
 
     try
     {
-        ShaderCompiler::batchCompile(shaders_directory_path, spv_directory_path);
+        config = EngineConfig::from_args(argc, argv);
     }
     catch (const std::runtime_error& e)
     {
-        LOG("Shaders compliation failed.", "MAIN", LogLevel::ERROR);
+        LOG(e.what(), "MAIN", LogLevel::ERROR);
+        std::cerr << std::endl << EngineConfig::usage();
 
-        std::cerr << std::endl << "======================== COMPILER OUTPUT ========================" << std::endl;
-        std::cerr << std::endl << e.what() << std::endl;
-        std::cerr << std::endl << "=================================================================" << std::endl;
+        return 1;
     }
 
     std::ifstream file_stream { header_file_path.string() };
@@ -32,7 +35,30 @@ int main(int argc, char* argv[])
         file_stream.close();
     }
 
-    Engine engine {};
+    if (!config.compare_path.empty())
+        return Snapshot::compare(config.compare_reference_path, config.compare_path) ? 0 : 1;
+
+    if (config.backend == Backend::CPU)
+    {
+        if (config.pressure_solver != PressureSolver::JACOBI)
+            LOG("The CPU backend only implements the Jacobi pressure solver.", "MAIN", LogLevel::WARNING);
+
+        if (config.advection != AdvectionScheme::SEMI_LAGRANGIAN)
+            LOG("The CPU backend only implements the semi-Lagrangian advection.", "MAIN", LogLevel::WARNING);
+
+        if (config.sampled_advection)
+            LOG("The CPU backend has no texture sampler, --sampled-advection ignored.", "MAIN", LogLevel::WARNING);
+
+        if (!config.restore_path.empty())
+            LOG("The CPU backend always starts from zero fields, --restore ignored.", "MAIN", LogLevel::WARNING);
+
+        CpuSolver solver { config };
+        solver.run(config);
+
+        return 0;
+    }
+
+    Engine engine { config };
 
     engine.init();
     engine.run();
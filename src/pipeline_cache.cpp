@@ -0,0 +1,158 @@
+#include "pipeline_cache.hpp"
+
+#include <cstring>
+#include <fstream>
+
+#include "logger.hpp"
+#include "result_check.hpp"
+
+void PipelineCache::init(VkDevice device, VkPhysicalDevice physical_device, const std::filesystem::path& cache_path)
+{
+    _cache_path = { cache_path };
+
+    VkPhysicalDeviceIDProperties id_properties {};
+    id_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &id_properties;
+
+    vkGetPhysicalDeviceProperties2(physical_device, &properties);
+
+    _device_header.magic          = { FILE_MAGIC };
+    _device_header.version        = { FILE_VERSION };
+    _device_header.vendor_id      = { properties.properties.vendorID };
+    _device_header.device_id      = { properties.properties.deviceID };
+    _device_header.driver_version = { properties.properties.driverVersion };
+    std::memcpy(_device_header.device_uuid, id_properties.deviceUUID, VK_UUID_SIZE);
+    std::memcpy(_device_header.pipeline_cache_uuid, properties.properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    std::vector<char> initial_data { _cache_path.empty() ? std::vector<char> {} : load_cache_data() };
+
+    VkPipelineCacheCreateInfo create_info {};
+    create_info.sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    create_info.pNext           = nullptr;
+    create_info.initialDataSize = initial_data.size();
+    create_info.pInitialData    = initial_data.empty() ? nullptr : initial_data.data();
+
+    result_check(vkCreatePipelineCache(device, &create_info, nullptr, &_pipeline_cache_handle));
+}
+
+void PipelineCache::destroy(VkDevice device)
+{
+    vkDestroyPipelineCache(device, _pipeline_cache_handle, nullptr);
+    _pipeline_cache_handle = { VK_NULL_HANDLE };
+}
+
+VkPipelineCache PipelineCache::handle() const
+{
+    return _pipeline_cache_handle;
+}
+
+std::vector<char> PipelineCache::load_cache_data() const
+{
+    std::ifstream file_stream { _cache_path, std::ios::binary };
+
+    if (!file_stream.is_open())
+    {
+        LOG("No pipeline cache at " + _cache_path.string() + ", pipelines will be compiled from SPIR-V.", COMPONENT_NAME);
+        return {};
+    }
+
+    FileHeader header {};
+
+    std::error_code error {};
+    uintmax_t file_size { std::filesystem::file_size(_cache_path, error) };
+
+    if (error
+        || !file_stream.read((char*)&header, sizeof(FileHeader))
+        || header.magic != FILE_MAGIC
+        || header.version != FILE_VERSION
+        || header.data_size != file_size - sizeof(FileHeader))
+    {
+        LOG("Pipeline cache " + _cache_path.string() + " is not valid, discarded.", COMPONENT_NAME, LogLevel::WARNING);
+        return {};
+    }
+
+    // Dispositivo o driver diversi: i dati non sono utilizzabili
+    bool same_device
+    {
+        header.vendor_id      == _device_header.vendor_id &&
+        header.device_id      == _device_header.device_id &&
+        header.driver_version == _device_header.driver_version &&
+        std::memcmp(header.device_uuid, _device_header.device_uuid, VK_UUID_SIZE) == 0 &&
+        std::memcmp(header.pipeline_cache_uuid, _device_header.pipeline_cache_uuid, VK_UUID_SIZE) == 0
+    };
+
+    if (!same_device)
+    {
+        LOG("Pipeline cache was created by a different device or driver, discarded.", COMPONENT_NAME, LogLevel::WARNING);
+        return {};
+    }
+
+    std::vector<char> data(header.data_size);
+
+    if (!file_stream.read(data.data(), data.size()) || hash(data) != header.data_hash)
+    {
+        LOG("Pipeline cache " + _cache_path.string() + " is truncated or corrupted, discarded.", COMPONENT_NAME, LogLevel::WARNING);
+        return {};
+    }
+
+    LOG("Pipeline cache loaded (" + std::to_string(data.size()) + " bytes).", COMPONENT_NAME);
+
+    return data;
+}
+
+void PipelineCache::save(VkDevice device) const
+{
+    size_t data_size {};
+    result_check(vkGetPipelineCacheData(device, _pipeline_cache_handle, &data_size, nullptr));
+
+    std::vector<char> data(data_size);
+    result_check(vkGetPipelineCacheData(device, _pipeline_cache_handle, &data_size, data.data()));
+    data.resize(data_size);
+
+    FileHeader header { _device_header };
+    header.data_size = { data.size() };
+    header.data_hash = { hash(data) };
+
+    // Scrittura su un file temporaneo e rename: un'interruzione non lascia mai un file a metà
+    std::error_code error {};
+    std::filesystem::path temporary_path { _cache_path.string() + ".tmp" };
+
+    if (_cache_path.has_parent_path())
+        std::filesystem::create_directories(_cache_path.parent_path(), error);
+
+    std::ofstream file_stream { temporary_path, std::ios::binary | std::ios::trunc };
+
+    if (!file_stream.write((const char*)&header, sizeof(FileHeader)) || !file_stream.write(data.data(), data.size()))
+    {
+        LOG("Could not write the pipeline cache to " + temporary_path.string() + ".", COMPONENT_NAME, LogLevel::WARNING);
+        return;
+    }
+
+    file_stream.close();
+    std::filesystem::rename(temporary_path, _cache_path, error);
+
+    if (error)
+    {
+        LOG("Could not write the pipeline cache to " + _cache_path.string() + ": " + error.message(), COMPONENT_NAME, LogLevel::WARNING);
+        return;
+    }
+
+    LOG("Pipeline cache saved (" + std::to_string(data.size()) + " bytes).", COMPONENT_NAME);
+}
+
+uint64_t PipelineCache::hash(const std::vector<char>& data)
+{
+    // FNV-1a a 64 bit: basta a riconoscere file troncati o sovrascritti
+    uint64_t value { 0xcbf29ce484222325ull };
+
+    for (char byte : data)
+    {
+        value ^= (uint8_t)byte;
+        value *= 0x100000001b3ull;
+    }
+
+    return value;
+}
@@ -0,0 +1,51 @@
+#ifndef PIPELINE_CACHE_HPP
+#define PIPELINE_CACHE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// VkPipelineCache salvata su disco tra un'esecuzione e l'altra. Il file ha
+// un'intestazione propria che lega i dati al dispositivo e alla versione
+// del driver: se non corrispondono la cache viene scartata e ricostruita.
+class PipelineCache {
+public:
+    static constexpr std::string COMPONENT_NAME { "PIPELINE_CACHE" };
+
+    // Loads cache_path if it was written by the same device and driver, otherwise starts empty.
+    void init(VkDevice device, VkPhysicalDevice physical_device, const std::filesystem::path& cache_path);
+    void destroy(VkDevice device);
+
+    // Writes the current cache content to disk (temporary file + rename).
+    void save(VkDevice device) const;
+
+    VkPipelineCache handle() const;
+
+private:
+    struct FileHeader
+    {
+        uint32_t magic                             {};
+        uint32_t version                           {};
+        uint32_t vendor_id                         {};
+        uint32_t device_id                         {};
+        uint32_t driver_version                    {};
+        uint8_t  device_uuid[VK_UUID_SIZE]         {};
+        uint8_t  pipeline_cache_uuid[VK_UUID_SIZE] {};
+        uint64_t data_size                         {};
+        uint64_t data_hash                         {};
+    };
+
+    static constexpr uint32_t FILE_MAGIC   { 0x48434344 }; // "DCCH"
+    static constexpr uint32_t FILE_VERSION { 1 };
+
+    VkPipelineCache       _pipeline_cache_handle {};
+    std::filesystem::path _cache_path            {};
+    FileHeader            _device_header         {};
+
+    std::vector<char> load_cache_data() const;
+    static uint64_t hash(const std::vector<char>& data);
+};
+
+#endif // PIPELINE_CACHE_HPP
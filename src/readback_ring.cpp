@@ -0,0 +1,123 @@
+#include "readback_ring.hpp"
+
+#include "logger.hpp"
+#include "result_check.hpp"
+
+void ReadbackRing::init(VmaAllocator allocator, size_t slot_size, uint32_t slot_count)
+{
+    _allocator = { allocator };
+    _slot_size = { slot_size };
+    _slots.resize(slot_count);
+
+    VkBufferCreateInfo buffer_create_info {};
+    buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.pNext = nullptr;
+    buffer_create_info.size  = slot_size;
+    buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    // Mappati per tutta la durata del ring: nessun vmaMapMemory nel frame loop
+    VmaAllocationCreateInfo buffer_alloc_info {};
+    buffer_alloc_info.usage = { VMA_MEMORY_USAGE_AUTO };
+    buffer_alloc_info.flags = { VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT };
+
+    for (Slot& slot : _slots)
+        result_check(vmaCreateBuffer(_allocator, &buffer_create_info, &buffer_alloc_info, &slot._buffer_handle, &slot._allocation, &slot._allocation_info));
+
+    _stop   = { false };
+    _worker = { std::thread { &ReadbackRing::worker_loop, this } };
+
+    LOG("Readback ring created with " + std::to_string(slot_count) + " slots of " + std::to_string(slot_size) + " bytes.", COMPONENT_NAME);
+}
+
+void ReadbackRing::destroy()
+{
+    if (!enabled())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock { _mutex };
+        _stop = { true };
+    }
+
+    _job_condition.notify_all();
+    _worker.join();
+
+    for (Slot& slot : _slots)
+        vmaDestroyBuffer(_allocator, slot._buffer_handle, slot._allocation);
+
+    _slots.clear();
+}
+
+bool ReadbackRing::enabled() const
+{
+    return !_slots.empty();
+}
+
+std::optional<uint32_t> ReadbackRing::acquire()
+{
+    std::lock_guard<std::mutex> lock { _mutex };
+
+    for (uint32_t i = 0; i < _slots.size(); ++i)
+    {
+        if (!_slots[i]._in_use)
+        {
+            _slots[i]._in_use = { true };
+            return i;
+        }
+    }
+
+    return std::nullopt;
+}
+
+VkBuffer ReadbackRing::buffer(uint32_t slot) const
+{
+    return _slots[slot]._buffer_handle;
+}
+
+void ReadbackRing::consume(uint32_t slot, Consumer&& consumer)
+{
+    {
+        std::lock_guard<std::mutex> lock { _mutex };
+        _jobs.emplace_back(slot, std::move(consumer));
+    }
+
+    _job_condition.notify_one();
+}
+
+void ReadbackRing::wait_idle()
+{
+    std::unique_lock<std::mutex> lock { _mutex };
+    _idle_condition.wait(lock, [this]() { return _jobs.empty() && !_busy; });
+}
+
+void ReadbackRing::worker_loop()
+{
+    for (;;)
+    {
+        std::unique_lock<std::mutex> lock { _mutex };
+        _job_condition.wait(lock, [this]() { return _stop || !_jobs.empty(); });
+
+        // Anche in chiusura si consumano le letture già consegnate
+        if (_jobs.empty())
+            return;
+
+        auto [slot_index, consumer] = std::move(_jobs.front());
+        _jobs.pop_front();
+        _busy = { true };
+
+        const Slot& slot { _slots[slot_index] };
+
+        lock.unlock();
+
+        // No-op sulla memoria host-coherent, necessario sulle altre
+        vmaInvalidateAllocation(_allocator, slot._allocation, 0, VK_WHOLE_SIZE);
+        consumer({ (const char*)slot._allocation_info.pMappedData, _slot_size });
+
+        lock.lock();
+        _slots[slot_index]._in_use = { false };
+        _busy = { false };
+
+        if (_jobs.empty())
+            _idle_condition.notify_all();
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef READBACK_RING_HPP
+#define READBACK_RING_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "vk_mem_alloc.h"
+
+// Anello di staging buffer host-visible, mappati una volta sola, per leggere
+// i campi dalla GPU senza stalli: il frame registra la copia in uno slot
+// libero e, quando il suo fence è già stato atteso, un thread dedicato passa
+// i dati al consumer e rimette lo slot a disposizione.
+class ReadbackRing {
+public:
+    static constexpr std::string COMPONENT_NAME { "READBACK_RING" };
+
+    using Consumer = std::function<void(std::span<const char> data)>;
+
+    void init(VmaAllocator allocator, size_t slot_size, uint32_t slot_count);
+    void destroy();
+
+    bool enabled() const;
+
+    // Free slot for a new copy, or std::nullopt when every slot is still in
+    // flight: the caller skips that readback instead of stalling the frame.
+    std::optional<uint32_t> acquire();
+    VkBuffer buffer(uint32_t slot) const;
+
+    // Call once the commands that fill slot have completed (fence or timeline
+    // already waited); consumer runs on the worker thread.
+    void consume(uint32_t slot, Consumer&& consumer);
+
+    // Blocks until every consumer submitted so far has returned.
+    void wait_idle();
+
+private:
+    struct Slot
+    {
+        VkBuffer          _buffer_handle   {};
+        VmaAllocation     _allocation      {};
+        VmaAllocationInfo _allocation_info {};
+        bool              _in_use          {};
+    };
+
+    VmaAllocator      _allocator {};
+    size_t            _slot_size {};
+    std::vector<Slot> _slots     {};
+
+    std::mutex                                _mutex          {};
+    std::condition_variable                   _job_condition  {};
+    std::condition_variable                   _idle_condition {};
+    std::deque<std::pair<uint32_t, Consumer>> _jobs           {};
+    bool                                      _busy           {};
+    bool                                      _stop           {};
+    std::thread                               _worker         {};
+
+    void worker_loop();
+};
+
+#endif // READBACK_RING_HPP
@@ -0,0 +1,208 @@
+#include "snapshot.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <vulkan/vulkan.h>
+
+#include "logger.hpp"
+
+// Da binary16 a binary32, denormali compresi.
+static float half_to_float(uint16_t half)
+{
+    uint32_t sign     { (uint32_t)(half & 0x8000) << 16 };
+    uint32_t exponent { (uint32_t)(half >> 10) & 0x1f };
+    uint32_t mantissa { (uint32_t)half & 0x3ff };
+
+    if (exponent == 0)
+    {
+        float value { std::ldexp((float)mantissa, -24) };
+        return sign ? -value : value;
+    }
+
+    if (exponent == 0x1f)
+        return std::bit_cast<float>(sign | 0x7f800000 | (mantissa << 13));
+
+    return std::bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+bool Snapshot::write(const std::filesystem::path& path, const Header& header, std::span<const char> velocity, std::span<const char> pressure)
+{
+    std::error_code error {};
+    std::filesystem::path temporary_path { path.string() + ".tmp" };
+
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path(), error);
+
+    std::ofstream file_stream { temporary_path, std::ios::binary | std::ios::trunc };
+
+    if (!file_stream.write((const char*)&header, sizeof(Header))
+        || !file_stream.write(velocity.data(), velocity.size())
+        || !file_stream.write(pressure.data(), pressure.size()))
+    {
+        LOG("Could not write the snapshot to " + temporary_path.string() + ".", COMPONENT_NAME, LogLevel::WARNING);
+        return false;
+    }
+
+    file_stream.close();
+    std::filesystem::rename(temporary_path, path, error);
+
+    if (error)
+    {
+        LOG("Could not write the snapshot to " + path.string() + ": " + error.message(), COMPONENT_NAME, LogLevel::WARNING);
+        return false;
+    }
+
+    LOG("Snapshot of step " + std::to_string(header.step_count) + " saved to " + path.string() + ".", COMPONENT_NAME);
+
+    return true;
+}
+
+std::filesystem::path Snapshot::export_file_path(const std::filesystem::path& directory, uint64_t step)
+{
+    std::string step_string { std::to_string(step) };
+
+    return directory / ("fields_" + std::string(10 - std::min<size_t>(step_string.size(), 10), '0') + step_string + ".snap");
+}
+
+std::optional<Snapshot> Snapshot::load(const std::filesystem::path& path)
+{
+    std::ifstream file_stream { path, std::ios::binary };
+
+    if (!file_stream.is_open())
+    {
+        LOG("No snapshot at " + path.string() + ".", COMPONENT_NAME, LogLevel::WARNING);
+        return std::nullopt;
+    }
+
+    Snapshot snapshot {};
+
+    std::error_code error {};
+    uintmax_t file_size { std::filesystem::file_size(path, error) };
+
+    if (error
+        || !file_stream.read((char*)&snapshot.header, sizeof(Header))
+        || snapshot.header.magic != FILE_MAGIC
+        || snapshot.header.version != FILE_VERSION
+        || snapshot.header.velocity_size + snapshot.header.pressure_size != file_size - sizeof(Header))
+    {
+        LOG("Snapshot " + path.string() + " is not valid or was written by another version.", COMPONENT_NAME, LogLevel::WARNING);
+        return std::nullopt;
+    }
+
+    snapshot.velocity.resize(snapshot.header.velocity_size);
+    snapshot.pressure.resize(snapshot.header.pressure_size);
+
+    if (!file_stream.read(snapshot.velocity.data(), snapshot.velocity.size())
+        || !file_stream.read(snapshot.pressure.data(), snapshot.pressure.size()))
+    {
+        LOG("Snapshot " + path.string() + " is truncated.", COMPONENT_NAME, LogLevel::WARNING);
+        return std::nullopt;
+    }
+
+    return snapshot;
+}
+
+std::vector<float> Snapshot::to_float(const std::vector<char>& texels, uint32_t format)
+{
+    switch (format)
+    {
+        case VK_FORMAT_R32_SFLOAT:
+        case VK_FORMAT_R32G32_SFLOAT:
+        {
+            std::vector<float> values(texels.size() / sizeof(float));
+            std::memcpy(values.data(), texels.data(), values.size() * sizeof(float));
+            return values;
+        }
+        case VK_FORMAT_R16_SFLOAT:
+        case VK_FORMAT_R16G16_SFLOAT:
+        {
+            std::vector<float> values(texels.size() / sizeof(uint16_t));
+
+            for (size_t i = 0; i < values.size(); ++i)
+            {
+                uint16_t half {};
+                std::memcpy(&half, texels.data() + i * sizeof(uint16_t), sizeof(uint16_t));
+                values[i] = { half_to_float(half) };
+            }
+
+            return values;
+        }
+        default:
+            return {};
+    }
+}
+
+std::vector<float> Snapshot::velocity_values() const
+{
+    return to_float(velocity, header.velocity_format);
+}
+
+std::vector<float> Snapshot::pressure_values() const
+{
+    return to_float(pressure, header.pressure_format);
+}
+
+bool Snapshot::compare(const std::filesystem::path& reference_path, const std::filesystem::path& path)
+{
+    std::optional<Snapshot> reference { load(reference_path) };
+    std::optional<Snapshot> other     { load(path) };
+
+    if (!reference || !other)
+        return false;
+
+    if (reference->header.width != other->header.width || reference->header.height != other->header.height)
+    {
+        LOG("Snapshots " + reference_path.string() + " and " + path.string() + " have different grids.", COMPONENT_NAME, LogLevel::WARNING);
+        return false;
+    }
+
+    if (reference->header.step_count != other->header.step_count)
+        LOG("Comparing snapshots of different steps (" + std::to_string(reference->header.step_count) + " and " + std::to_string(other->header.step_count) + ").", COMPONENT_NAME, LogLevel::WARNING);
+
+    // Errore massimo e RMS, assoluti e relativi al valore massimo del riferimento
+    auto compare_field = [](const std::string& name, const std::vector<float>& expected, const std::vector<float>& actual)
+    {
+        if (expected.empty() || expected.size() != actual.size())
+        {
+            LOG("Field " + name + " has an unknown format, not compared.", COMPONENT_NAME, LogLevel::WARNING);
+            return false;
+        }
+
+        double max_error     {};
+        double squared_error {};
+        double max_value     {};
+
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            double error { std::abs((double)actual[i] - expected[i]) };
+
+            max_error      = { std::max(max_error, error) };
+            squared_error += error * error;
+            max_value      = { std::max(max_value, (double)std::abs(expected[i])) };
+        }
+
+        double rms_error { std::sqrt(squared_error / expected.size()) };
+        double scale     { max_value > 0.0 ? max_value : 1.0 };
+
+        std::ostringstream message {};
+        message << std::scientific << std::setprecision(3)
+                << name << ": max error " << max_error << " (" << max_error / scale * 100.0 << "%), "
+                << "RMS error " << rms_error << " (" << rms_error / scale * 100.0 << "%), "
+                << "max |reference| " << max_value << ".";
+
+        LOG(message.str(), COMPONENT_NAME);
+
+        return true;
+    };
+
+    bool velocity_compared { compare_field("Velocity", reference->velocity_values(), other->velocity_values()) };
+    bool pressure_compared { compare_field("Pressure", reference->pressure_values(), other->pressure_values()) };
+
+    return velocity_compared && pressure_compared;
+}
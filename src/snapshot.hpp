@@ -0,0 +1,62 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// Formato binario dei checkpoint: un header versionato seguito dai texel del
+// campo di velocità e di quello di pressione, riga per riga e senza padding.
+class Snapshot {
+public:
+    static constexpr std::string COMPONENT_NAME { "SNAPSHOT" };
+
+    static constexpr uint32_t FILE_MAGIC   { 0x4e534344 }; // "DCSN"
+    static constexpr uint32_t FILE_VERSION { 1 };
+
+    struct Header
+    {
+        uint32_t magic           {};
+        uint32_t version         {};
+        uint32_t width           {};
+        uint32_t height          {};
+        uint32_t velocity_format {}; // VkFormat
+        uint32_t pressure_format {}; // VkFormat
+        uint64_t step_count      {};
+        float    delta_time      {};
+        uint32_t reserved        {};
+        uint64_t velocity_size   {};
+        uint64_t pressure_size   {};
+    };
+
+    Header            header   {};
+    std::vector<char> velocity {};
+    std::vector<char> pressure {};
+
+    // Writes to a temporary file next to path and renames it, so an interrupted
+    // write never replaces the previous snapshot with a truncated one.
+    static bool write(const std::filesystem::path& path, const Header& header, std::span<const char> velocity, std::span<const char> pressure);
+
+    // File of the export taken at step inside directory (fields_<step>.snap, zero padded).
+    static std::filesystem::path export_file_path(const std::filesystem::path& directory, uint64_t step);
+
+    // Returns std::nullopt (after logging why) when the file is missing, truncated or of another version.
+    static std::optional<Snapshot> load(const std::filesystem::path& path);
+
+    // Logs the maximum and RMS difference between the fields of two snapshots of
+    // the same grid, e.g. an fp16 run against the fp32 reference. Returns false
+    // when they cannot be compared.
+    static bool compare(const std::filesystem::path& reference_path, const std::filesystem::path& path);
+
+    // Texels converted to float, whatever the storage precision (empty for unknown formats).
+    std::vector<float> velocity_values() const;
+    std::vector<float> pressure_values() const;
+
+private:
+    static std::vector<float> to_float(const std::vector<char>& texels, uint32_t format);
+};
+
+#endif // SNAPSHOT_HPP
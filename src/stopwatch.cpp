@@ -17,6 +17,11 @@ int64_t Stopwatch::elapsed()
     return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _start_point).count();
 }
 
+double Stopwatch::elapsed_milliseconds()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start_point).count();
+}
+
 std::string Stopwatch::elapsed_as_string()
 {
     return std::to_string(elapsed()) + "ms";
@@ -14,6 +14,7 @@ public:
     void print();
 
     int64_t elapsed();
+    double elapsed_milliseconds();
     std::string elapsed_as_string();
 
 private:
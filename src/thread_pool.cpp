@@ -0,0 +1,99 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t thread_count)
+{
+    if (thread_count == 0)
+        thread_count = { std::max<size_t>(std::thread::hardware_concurrency(), 1) };
+
+    // Il thread chiamante esegue l'ultimo blocco di ogni parallel_for
+    for (size_t i = 0; i + 1 < thread_count; ++i)
+        _workers.emplace_back(&ThreadPool::worker_loop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock { _mutex };
+        _stop = { true };
+    }
+
+    _start_condition.notify_all();
+
+    for (std::thread& worker : _workers)
+        worker.join();
+}
+
+size_t ThreadPool::size() const
+{
+    return _workers.size() + 1;
+}
+
+std::pair<size_t, size_t> ThreadPool::chunk(size_t part) const
+{
+    size_t parts { _workers.size() + 1 };
+    size_t count { _end - _begin };
+
+    return { _begin + count * part / parts, _begin + count * (part + 1) / parts };
+}
+
+void ThreadPool::parallel_for(size_t begin, size_t end, const Task& task)
+{
+    if (begin >= end)
+        return;
+
+    if (_workers.empty() || end - begin == 1)
+    {
+        task(begin, end);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock { _mutex };
+        _task    = { &task };
+        _begin   = { begin };
+        _end     = { end };
+        _pending = { _workers.size() };
+        _generation++;
+    }
+
+    _start_condition.notify_all();
+
+    auto [chunk_begin, chunk_end] = chunk(_workers.size());
+
+    if (chunk_begin < chunk_end)
+        task(chunk_begin, chunk_end);
+
+    std::unique_lock<std::mutex> lock { _mutex };
+    _done_condition.wait(lock, [this]() { return _pending == 0; });
+}
+
+void ThreadPool::worker_loop(size_t worker_index)
+{
+    uint64_t seen_generation {};
+
+    for (;;)
+    {
+        std::unique_lock<std::mutex> lock { _mutex };
+        _start_condition.wait(lock, [&]() { return _stop || _generation != seen_generation; });
+
+        if (_stop)
+            return;
+
+        seen_generation = { _generation };
+
+        const Task* task { _task };
+        auto [chunk_begin, chunk_end] = chunk(worker_index);
+
+        lock.unlock();
+
+        if (chunk_begin < chunk_end)
+            (*task)(chunk_begin, chunk_end);
+
+        lock.lock();
+
+        if (--_pending == 0)
+            _done_condition.notify_one();
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Pool di thread persistenti per i cicli paralleli del backend CPU: ogni
+// parallel_for divide l'intervallo in blocchi contigui, uno per thread
+// (chiamante compreso), e ritorna quando tutti hanno finito.
+class ThreadPool {
+public:
+    using Task = std::function<void(size_t begin, size_t end)>;
+
+    // thread_count includes the calling thread; 0 uses every hardware thread.
+    explicit ThreadPool(size_t thread_count = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const;
+
+    void parallel_for(size_t begin, size_t end, const Task& task);
+
+private:
+    std::vector<std::thread> _workers {};
+
+    std::mutex              _mutex           {};
+    std::condition_variable _start_condition {};
+    std::condition_variable _done_condition  {};
+
+    const Task* _task       {};
+    size_t      _begin      {};
+    size_t      _end        {};
+    size_t      _pending    {};
+    uint64_t    _generation {};
+    bool        _stop       {};
+
+    void worker_loop(size_t worker_index);
+    std::pair<size_t, size_t> chunk(size_t part) const;
+};
+
+#endif // THREAD_POOL_HPP
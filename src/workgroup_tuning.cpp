@@ -0,0 +1,156 @@
+#include "workgroup_tuning.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "logger.hpp"
+
+void WorkgroupTuning::init(VkPhysicalDevice physical_device, const std::filesystem::path& tuning_path, VkExtent2D grid_extent, bool half_precision)
+{
+    _tuning_path = { tuning_path };
+
+    VkPhysicalDeviceIDProperties id_properties {};
+    id_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &id_properties;
+
+    vkGetPhysicalDeviceProperties2(physical_device, &properties);
+
+    _device_header.magic          = { FILE_MAGIC };
+    _device_header.version        = { FILE_VERSION };
+    _device_header.vendor_id      = { properties.properties.vendorID };
+    _device_header.device_id      = { properties.properties.deviceID };
+    _device_header.driver_version = { properties.properties.driverVersion };
+    _device_header.grid_width     = { grid_extent.width };
+    _device_header.grid_height    = { grid_extent.height };
+    _device_header.half_precision = { half_precision ? 1u : 0u };
+    std::memcpy(_device_header.device_uuid, id_properties.deviceUUID, VK_UUID_SIZE);
+
+    if (!_tuning_path.empty())
+        load();
+}
+
+std::optional<VkExtent2D> WorkgroupTuning::find(const std::string& kernel_name) const
+{
+    for (const Entry& entry : _entries)
+    {
+        if (kernel_name == entry.kernel_name)
+            return VkExtent2D { entry.width, entry.height };
+    }
+
+    return std::nullopt;
+}
+
+void WorkgroupTuning::set(const std::string& kernel_name, VkExtent2D workgroup_size)
+{
+    auto entry_it = std::find_if(_entries.begin(), _entries.end(), [&](const Entry& entry) { return kernel_name == entry.kernel_name; });
+
+    if (entry_it == _entries.end())
+    {
+        Entry entry {};
+        kernel_name.copy(entry.kernel_name, MAX_KERNEL_NAME - 1);
+
+        entry_it = { _entries.insert(_entries.end(), entry) };
+    }
+
+    entry_it->width  = { workgroup_size.width };
+    entry_it->height = { workgroup_size.height };
+}
+
+void WorkgroupTuning::load()
+{
+    std::ifstream file_stream { _tuning_path, std::ios::binary };
+
+    if (!file_stream.is_open())
+    {
+        LOG("No workgroup tuning at " + _tuning_path.string() + ", using the configured workgroup size.", COMPONENT_NAME);
+        return;
+    }
+
+    FileHeader header {};
+
+    // Il numero di voci deve corrispondere alla dimensione del file prima di allocarle
+    std::error_code error {};
+    uintmax_t file_size { std::filesystem::file_size(_tuning_path, error) };
+
+    if (error
+        || !file_stream.read((char*)&header, sizeof(FileHeader))
+        || header.magic != FILE_MAGIC
+        || header.version != FILE_VERSION
+        || (uintmax_t)header.entry_count * sizeof(Entry) != file_size - sizeof(FileHeader))
+    {
+        LOG("Workgroup tuning " + _tuning_path.string() + " is not valid, discarded.", COMPONENT_NAME, LogLevel::WARNING);
+        return;
+    }
+
+    // Le misure valgono solo per lo stesso dispositivo, driver, griglia e formato dei campi
+    bool same_setup
+    {
+        header.vendor_id      == _device_header.vendor_id &&
+        header.device_id      == _device_header.device_id &&
+        header.driver_version == _device_header.driver_version &&
+        header.grid_width     == _device_header.grid_width &&
+        header.grid_height    == _device_header.grid_height &&
+        header.half_precision == _device_header.half_precision &&
+        std::memcmp(header.device_uuid, _device_header.device_uuid, VK_UUID_SIZE) == 0
+    };
+
+    if (!same_setup)
+    {
+        LOG("Workgroup tuning was measured on a different device, driver or grid, discarded.", COMPONENT_NAME, LogLevel::WARNING);
+        return;
+    }
+
+    std::vector<Entry> entries(header.entry_count);
+
+    if (!file_stream.read((char*)entries.data(), entries.size() * sizeof(Entry)))
+    {
+        LOG("Workgroup tuning " + _tuning_path.string() + " is truncated, discarded.", COMPONENT_NAME, LogLevel::WARNING);
+        return;
+    }
+
+    for (Entry& entry : entries)
+        entry.kernel_name[MAX_KERNEL_NAME - 1] = { '\0' };
+
+    _entries = { std::move(entries) };
+
+    LOG("Workgroup tuning loaded (" + std::to_string(_entries.size()) + " kernels).", COMPONENT_NAME);
+}
+
+void WorkgroupTuning::save() const
+{
+    if (_tuning_path.empty())
+        return;
+
+    FileHeader header { _device_header };
+    header.entry_count = { (uint32_t)_entries.size() };
+
+    // Scrittura su un file temporaneo e rename, come per la pipeline cache
+    std::error_code error {};
+    std::filesystem::path temporary_path { _tuning_path.string() + ".tmp" };
+
+    if (_tuning_path.has_parent_path())
+        std::filesystem::create_directories(_tuning_path.parent_path(), error);
+
+    std::ofstream file_stream { temporary_path, std::ios::binary | std::ios::trunc };
+
+    if (!file_stream.write((const char*)&header, sizeof(FileHeader)) || !file_stream.write((const char*)_entries.data(), _entries.size() * sizeof(Entry)))
+    {
+        LOG("Could not write the workgroup tuning to " + temporary_path.string() + ".", COMPONENT_NAME, LogLevel::WARNING);
+        return;
+    }
+
+    file_stream.close();
+    std::filesystem::rename(temporary_path, _tuning_path, error);
+
+    if (error)
+    {
+        LOG("Could not write the workgroup tuning to " + _tuning_path.string() + ": " + error.message(), COMPONENT_NAME, LogLevel::WARNING);
+        return;
+    }
+
+    LOG("Workgroup tuning saved (" + std::to_string(_entries.size()) + " kernels).", COMPONENT_NAME);
+}
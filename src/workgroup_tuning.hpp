@@ -0,0 +1,62 @@
+#ifndef WORKGROUP_TUNING_HPP
+#define WORKGROUP_TUNING_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Dimensioni dei workgroup scelte dall'autotuner, una per kernel, salvate su
+// disco tra un'esecuzione e l'altra. Come per la pipeline cache, l'intestazione
+// lega i risultati al dispositivo, al driver, alla griglia e alla precisione dei
+// campi: se non corrispondono il file viene ignorato.
+class WorkgroupTuning {
+public:
+    static constexpr std::string COMPONENT_NAME { "WG_TUNING" };
+
+    // Loads tuning_path if it was written for the same device, driver, grid and precision.
+    void init(VkPhysicalDevice physical_device, const std::filesystem::path& tuning_path, VkExtent2D grid_extent, bool half_precision);
+
+    std::optional<VkExtent2D> find(const std::string& kernel_name) const;
+    void set(const std::string& kernel_name, VkExtent2D workgroup_size);
+
+    // Writes every tuned kernel to disk (temporary file + rename).
+    void save() const;
+
+private:
+    static constexpr size_t MAX_KERNEL_NAME { 48 };
+
+    struct FileHeader
+    {
+        uint32_t magic                     {};
+        uint32_t version                   {};
+        uint32_t vendor_id                 {};
+        uint32_t device_id                 {};
+        uint32_t driver_version            {};
+        uint8_t  device_uuid[VK_UUID_SIZE] {};
+        uint32_t grid_width                {};
+        uint32_t grid_height               {};
+        uint32_t half_precision            {};
+        uint32_t entry_count               {};
+    };
+
+    struct Entry
+    {
+        char     kernel_name[MAX_KERNEL_NAME] {};
+        uint32_t width                        {};
+        uint32_t height                       {};
+    };
+
+    static constexpr uint32_t FILE_MAGIC   { 0x47574344 }; // "DCWG"
+    static constexpr uint32_t FILE_VERSION { 1 };
+
+    std::filesystem::path _tuning_path   {};
+    FileHeader            _device_header {};
+    std::vector<Entry>    _entries       {};
+
+    void load();
+};
+
+#endif // WORKGROUP_TUNING_HPP